@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# The allocation check
+#
+# Feeds player N games and then 10N games through the hub, for 2, 3 and 4
+# players over each transport (text pipes, -b binary, -m shared memory),
+# counting the allocations the player processes make with allocount.so.
+# The players play by their default strategy, whatever LOVELETTER_STRATEGY
+# says.
+# Whatever a player allocates must be allocated once, at startup: if the
+# count for 10N games is any higher than for N, it allocates in steady
+# state and the check fails. So does a count of nothing at all, as every
+# player allocates something at startup: the counter is not counting.
+#
+# Each run is one line under a header: the transport, the number of
+# players and the allocations of all the players over N and 10N games.
+#
+# Usage: allocbench.sh [-n games] deckfile hub player allocount.so
+
+usage() {
+    echo "Usage: allocbench.sh [-n games] deckfile hub player allocount.so" >&2
+    exit 1
+}
+
+games=100
+if [ "$1" = "-n" ]; then
+    games=$2
+    shift 2
+fi
+case $games in
+    ''|*[!0-9]*) usage ;;
+esac
+if [ $# -ne 4 ] || [ "$games" -lt 1 ]; then
+    usage
+fi
+deckfile=$1
+hub=$2
+player=$3
+counter=$(realpath "$4") || exit 1
+countFile=$(mktemp) || exit 1
+trap 'rm -f "$countFile"' EXIT
+
+# Prints the allocations of the player processes over a hub run playing
+# $1 games with the hub options $2 and $3 players. Returns non-zero if the
+# hub fails.
+count_allocations() {
+    head -c 8 /dev/zero > "$countFile"
+    players=""
+    for i in $(seq "$3"); do
+        players="$players $player"
+    done
+    env -u LOVELETTER_STRATEGY LD_PRELOAD="$counter" \
+            ALLOCOUNT_PROGRAM=$(basename "$player") \
+            ALLOCOUNT_FILE="$countFile" \
+            "$hub" -g "$1" $2 "$deckfile" $players > /dev/null || return 1
+    od -An -t u8 "$countFile" | tr -d ' '
+}
+
+# Exits unless $1 is a count of at least one allocation
+check_count() {
+    case $1 in
+        ''|*[!0-9]*)
+            echo "Bad allocation count '$1'" >&2
+            exit 3
+            ;;
+    esac
+    if [ "$1" -eq 0 ]; then
+        echo "No allocations counted" >&2
+        exit 3
+    fi
+}
+
+failed=0
+echo "transport players allocs/$games allocs/$((10 * games))"
+for transport in text binary shm; do
+    case $transport in
+        text) options="" ;;
+        binary) options="-b" ;;
+        shm) options="-m" ;;
+    esac
+    for n in 2 3 4; do
+        few=$(count_allocations "$games" "$options" $n) || {
+            echo "Hub failed" >&2
+            exit 3
+        }
+        check_count "$few"
+        many=$(count_allocations $((10 * games)) "$options" $n) || {
+            echo "Hub failed" >&2
+            exit 3
+        }
+        check_count "$many"
+        echo "$transport $n $few $many"
+        if [ "$many" -gt "$few" ]; then
+            failed=1
+        fi
+    done
+done
+if [ $failed -ne 0 ]; then
+    echo "Allocations grew with the games played" >&2
+    exit 2
+fi
+exit 0
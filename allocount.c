@@ -0,0 +1,78 @@
+/*
+ * The allocation counter (allocount.so)
+ *
+ * Preloaded into the hub, and so into the player processes it starts,
+ * this counts every malloc, calloc and realloc made by a process running
+ * the program named in ALLOCOUNT_PROGRAM. The count is kept in the first
+ * 8 bytes of the file named in ALLOCOUNT_FILE, mapped shared, so the
+ * players add to the same count and it survives them being killed.
+ * Processes running anything else allocate as usual, uncounted.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* The environment variables naming what to count and where */
+#define PROGRAM_ENV "ALLOCOUNT_PROGRAM"
+#define FILE_ENV "ALLOCOUNT_FILE"
+
+/* The allocators underneath */
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t number, size_t size);
+void* __libc_realloc(void* old, size_t size);
+
+/* The shared count, or NULL if this process is not counted */
+static uint64_t* count = NULL;
+
+/*
+ * Maps the count if this process runs the program to be counted.
+ */
+__attribute__((constructor)) static void start_counting(void) {
+    char* program = getenv(PROGRAM_ENV);
+    char* path = getenv(FILE_ENV);
+
+    if (program == NULL || path == NULL ||
+            strcmp(program, program_invocation_short_name) != 0) {
+        return;
+    }
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        return;
+    }
+    void* mapped = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped != MAP_FAILED) {
+        count = mapped;
+    }
+}
+
+/*
+ * Counts one allocation, if this process is counted.
+ */
+static void count_allocation(void) {
+    if (count != NULL) {
+        __atomic_add_fetch(count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void* malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t number, size_t size) {
+    count_allocation();
+    return __libc_calloc(number, size);
+}
+
+void* realloc(void* old, size_t size) {
+    count_allocation();
+    return __libc_realloc(old, size);
+}
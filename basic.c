@@ -0,0 +1,219 @@
+/*
+ * The basic strategy: the bundled player program's original rules, as an
+ * in-process Strategy. The player program now aims and guesses from its
+ * beliefs (belief.h); basic stays as it was, which the lockstep engine
+ * plays too.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "loveletter.h"
+
+/*Common shifts for ints and chars*/
+#define SHIFT_NUMBER 48
+
+/* What the strategy knows about a player (one per player, including
+ * itself)
+ * - protected: if the player is protected (last discarded a 4)
+ * - outOfRound: if the player is out of the current round
+ * - playedCards: an array of the cards played by this player
+ * - numberPlayed: the number of cards this player has played
+ */
+typedef struct Opponent {
+    bool protected;
+    bool outOfRound;
+    int playedCards[DECK_SIZE];
+    int numberPlayed;
+} Opponent;
+
+/* The state of a seat played by the basic strategy
+ * - label: the seat's label
+ * - cards: the cards the seat is holding ('1' to '8', or 0 for none)
+ * - numberPlayers: the number of players in the game
+ * - players: what is known about each player
+ */
+typedef struct Basic {
+    char label;
+    char cards[2];
+    int numberPlayers;
+    Opponent players[MAX_PLAYERS];
+} Basic;
+
+/*
+ * Makes the state for a seat.
+ */
+static void* basic_create(int numPlayers, char label) {
+    Basic* basic = calloc(1, sizeof(Basic));
+    basic->label = label;
+    basic->numberPlayers = numPlayers;
+    return basic;
+}
+
+/*
+ * Records that the player at index played (or was forced to drop) card.
+ */
+static void add_played(Basic* basic, int player, char card) {
+    Opponent* opponent = &basic->players[player];
+
+    //a compare loser is reported without their card
+    if (card >= '1' && card <= '8' && opponent->numberPlayed < DECK_SIZE) {
+        opponent->playedCards[opponent->numberPlayed++] =
+                card - SHIFT_NUMBER;
+    }
+}
+
+/*
+ * newround: hold only card, and forget the last round.
+ */
+static void basic_newround(void* state, char card) {
+    Basic* basic = state;
+    basic->cards[0] = card;
+    basic->cards[1] = 0;
+    memset(basic->players, 0, sizeof(basic->players));
+}
+
+/*
+ * Returns the card that should be guessed. Returns '-' unless the card
+ * is a 1. If the card is a 1, guess is chosen by choosing the highest
+ * card that has not yet been played.
+ */
+static char get_guess(int choice, const Basic* basic) {
+    int numberPlayed[8] = {0};
+
+    if (choice != 1) {
+        return '-';
+    }
+    //get how many of each card have been played
+    for (int i = 0; i < basic->numberPlayers; i++) {
+        for (int j = 0; j < basic->players[i].numberPlayed; j++) {
+            numberPlayed[basic->players[i].playedCards[j] - 1] += 1;
+        }
+    }
+    //get the highest card that has not all been played, cannot guess 1
+    for (int n = 7; n > 0; n--) {
+        if (numberPlayed[n] < cardCopies[n + 1]) {
+            return n + 1 + SHIFT_NUMBER;
+        }
+    }
+    return '-';
+}
+
+/*
+ * Find and target a player given the choice, writing the move. Target is
+ * the first unprotected and still playing player following this seat, so
+ * seat B in a 4 player game checks C and D before A. If no one else can
+ * be targeted a 5 targets this seat and other cards target no one.
+ */
+static void target_player(Basic* basic, int choice, char move[3]) {
+    int me = basic->label - SHIFT;
+
+    for (int k = 1; k < basic->numberPlayers; k++) {
+        int i = (me + k) % basic->numberPlayers;
+        //if unprotected and not out of round
+        if (!basic->players[i].protected && !basic->players[i].outOfRound) {
+            move[1] = i + SHIFT;
+            move[2] = get_guess(choice, basic);
+            return;
+        }
+    }
+    move[1] = choice == 5 ? basic->label : '-';
+    move[2] = '-';
+}
+
+/*
+ * Chooses which of the two held cards to discard:
+ * 1. if one is a seven and the other a 5 or 6, the seven is discarded.
+ * 2. otherwise the lower of the two is chosen.
+ * 3. if a target is required, then target_player is called.
+ */
+static void basic_yourturn(void* state, char card, char move[3]) {
+    Basic* basic = state;
+    Opponent* me = &basic->players[basic->label - SHIFT];
+    char first;
+    char second;
+    char choice; //the card chosen to discard
+
+    //add card to the hand
+    if (basic->cards[0] == 0) {
+        basic->cards[0] = card;
+    } else {
+        basic->cards[1] = card;
+    }
+    first = basic->cards[0];
+    second = basic->cards[1];
+
+    //if you hold 7 and either 5 or 6, then discard 7, else the lower one
+    if (first == '7' && (second == '5' || second == '6')) {
+        choice = first;
+    } else if (second == '7' && (first == '5' || first == '6')) {
+        choice = second;
+    } else if (first < second || second == 0) {
+        choice = first;
+    } else {
+        choice = second;
+    }
+    basic->cards[0] = choice == first ? second : first;
+    basic->cards[1] = 0;
+
+    //our own protection is over
+    me->protected = false;
+    move[0] = choice;
+    move[1] = '-';
+    move[2] = '-';
+    if (choice == '1' || choice == '3' || choice == '5' || choice == '6') {
+        target_player(basic, choice - SHIFT_NUMBER, move);
+    }
+    add_played(basic, basic->label - SHIFT, choice);
+    me->protected = choice == '4';
+}
+
+/*
+ * thishappened: record the move of another player, any forced drop and
+ * any elimination.
+ */
+static void basic_thishappened(void* state, const Event* event) {
+    Basic* basic = state;
+    int moveMaker = event->player - SHIFT;
+
+    //our own move was recorded when we made it
+    if (event->player != basic->label) {
+        add_played(basic, moveMaker, event->card);
+        basic->players[moveMaker].protected = event->card == '4';
+    }
+    //a 4 dropped because of a 5 does not protect (the hub agrees)
+    if (event->dropper != '-') {
+        add_played(basic, event->dropper - SHIFT, event->dropped);
+    }
+    if (event->eliminated != '-') {
+        basic->players[event->eliminated - SHIFT].outOfRound = true;
+        if (event->eliminated == basic->label) {
+            basic->cards[0] = 0;
+            basic->cards[1] = 0;
+        }
+    }
+}
+
+/*
+ * replace: the card held is replaced with card.
+ */
+static void basic_replace(void* state, char card) {
+    Basic* basic = state;
+    basic->cards[0] = card;
+}
+
+/*
+ * scores: nothing to do.
+ */
+static void basic_scores(void* state, const int* scores, int numPlayers) {
+}
+
+/* The basic strategy */
+const Strategy basicStrategy = {
+    basic_create,
+    free,
+    basic_newround,
+    basic_yourturn,
+    basic_thishappened,
+    basic_replace,
+    basic_scores
+};
@@ -0,0 +1,15 @@
+/*
+ * The basic strategy as a plugin, so that anything that loads strategies
+ * (for example hub lib:./basic.so) can play it with no process of its
+ * own.
+ */
+
+#include <stddef.h>
+#include "loveletter.h"
+
+/*
+ * The plugin entry point (see STRATEGY_SYMBOL).
+ */
+const Strategy* loveletter_strategy(int abi) {
+    return abi == STRATEGY_ABI ? &basicStrategy : NULL;
+}
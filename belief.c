@@ -0,0 +1,299 @@
+/*
+ * Beliefs about the cards of a round (libloveletter)
+ *
+ * A seat playing a card from two held the one it keeps is either the one
+ * it held (it played the card just dealt) or the card just dealt (it
+ * played the one it held). Weighing the first by the seat's old weights
+ * and the second by the unseen copies, the chance of each card kept
+ * works out as the odds of playing the card played over the card kept,
+ * times the card's old weight plus the played card's old weight; the
+ * unseen copies cancel out. Those odds are the one guess made about how
+ * seats play: the lower of two cards LOWER_ODDS times as often as the
+ * higher, and never a 5 or 6 over a 7.
+ */
+
+#include <string.h>
+#include "loveletter.h"
+#include "belief.h"
+
+/* How many times likelier a seat is to play the lower of two cards */
+#define LOWER_ODDS 3.0
+
+/*
+ * Starts seat over as holding a card just dealt: any card fits.
+ */
+static void fresh_weights(Belief* belief, int seat) {
+    for (int c = 1; c <= 8; c++) {
+        belief->weight[seat][c] = 1;
+    }
+    belief->known[seat] = 0;
+}
+
+/*
+ * Scales seat's weights so the largest is 1, so they never run down to
+ * nothing. If no card fits at all (it was worked out from the odds, which
+ * some seats break), seat starts over.
+ */
+static void scale_weights(Belief* belief, int seat) {
+    double* weight = belief->weight[seat];
+    double largest = 0;
+
+    for (int c = 1; c <= 8; c++) {
+        if (weight[c] > largest) {
+            largest = weight[c];
+        }
+    }
+    if (largest == 0) {
+        fresh_weights(belief, seat);
+        return;
+    }
+    for (int c = 1; c <= 8; c++) {
+        weight[c] /= largest;
+    }
+}
+
+/*
+ * Starts belief over for a new round of numPlayers players, held by the
+ * seat labelled label: nothing seen, anyone may hold anything.
+ */
+void reset_belief(Belief* belief, int numPlayers, char label) {
+    belief->seat = label - 'A';
+    belief->numPlayers = numPlayers;
+    memcpy(belief->remaining, cardCopies, sizeof(cardCopies));
+    for (int i = 0; i < BELIEF_SEATS; i++) {
+        fresh_weights(belief, i);
+    }
+    belief->givenAway = 0;
+}
+
+/*
+ * Counts card as seen by the seat believing.
+ */
+void belief_see_card(Belief* belief, char card) {
+    int c = card - '0';
+
+    if (c >= 1 && c <= 8 && belief->remaining[c] > 0) {
+        belief->remaining[c]--;
+    }
+}
+
+/*
+ * Updates belief for a replace: the seat believing held held and is
+ * given card in its place.
+ */
+void belief_replace(Belief* belief, char held, char card) {
+    belief->givenAway = held - '0';
+    belief_see_card(belief, card);
+}
+
+/*
+ * Returns the odds of a seat holding played and kept playing played.
+ */
+static double play_odds(int played, int kept) {
+    if (played == 7 && (kept == 5 || kept == 6)) {
+        return 1;
+    }
+    if ((played == 5 || played == 6) && kept == 7) {
+        return 0;
+    }
+    if (played == kept) {
+        return 1;
+    }
+    return (played < kept ? LOWER_ODDS : 1) / (LOWER_ODDS + 1);
+}
+
+/*
+ * Updates belief for seat playing played (a card) from its two.
+ */
+static void play_card(Belief* belief, int seat, int played) {
+    double* weight = belief->weight[seat];
+    int known = belief->known[seat];
+
+    if (known == played) {
+        //it kept what it was dealt (a second copy is too unlikely)
+        fresh_weights(belief, seat);
+        for (int c = 1; c <= 8; c++) {
+            weight[c] = play_odds(played, c);
+        }
+        return;
+    }
+    belief_see_card(belief, played + '0');
+    if (known != 0) {
+        //it played what it was dealt
+        return;
+    }
+    double playedWeight = weight[played];
+    for (int c = 1; c <= 8; c++) {
+        weight[c] = play_odds(played, c) * (weight[c] + playedWeight);
+    }
+    scale_weights(belief, seat);
+}
+
+/*
+ * Updates belief for seat dropping dropped (a card) and, unless it is
+ * out, being dealt another.
+ */
+static void drop_card(Belief* belief, int seat, int dropped) {
+    if (belief->known[seat] != dropped) {
+        belief_see_card(belief, dropped + '0');
+    }
+    fresh_weights(belief, seat);
+}
+
+/*
+ * Updates belief for winner holding a higher card than loser.
+ */
+static void compare_cards(Belief* belief, int winner, int loser) {
+    double* weight = belief->weight[winner];
+    double below = 0; //the chance loser holds a card below c
+
+    if (winner == belief->seat || loser == belief->seat ||
+            belief->known[winner] != 0) {
+        return;
+    }
+    for (int c = 1; c <= 8; c++) {
+        double chance = card_chance(belief, loser, c + '0');
+        weight[c] *= below;
+        below += chance;
+    }
+    scale_weights(belief, winner);
+}
+
+/*
+ * Updates belief for seats first and second holding the same card, held
+ * being what the seat believing holds.
+ */
+static void tie_cards(Belief* belief, int first, int second, char held) {
+    int* known = belief->known;
+
+    if (first == belief->seat || second == belief->seat) {
+        int other = first == belief->seat ? second : first;
+        if (known[other] == 0) {
+            belief_see_card(belief, held);
+        }
+        known[other] = held - '0';
+    } else if (known[first] != 0 || known[second] != 0) {
+        int card = known[first] != 0 ? known[first] : known[second];
+        if (known[first] == 0 || known[second] == 0) {
+            belief_see_card(belief, card + '0');
+        }
+        known[first] = card;
+        known[second] = card;
+    } else {
+        //both of two more copies are unseen
+        for (int c = 1; c <= 8; c++) {
+            double both = belief->weight[first][c] *
+                    belief->weight[second][c] *
+                    (belief->remaining[c] > 1 ? belief->remaining[c] - 1 : 0);
+            belief->weight[first][c] = both;
+            belief->weight[second][c] = both;
+        }
+        scale_weights(belief, first);
+        scale_weights(belief, second);
+    }
+}
+
+/*
+ * Updates belief for seats first and second swapping cards.
+ */
+static void swap_cards(Belief* belief, int first, int second) {
+    if (first == belief->seat || second == belief->seat) {
+        //the other now holds what the seat believing gave away
+        int other = first == belief->seat ? second : first;
+        fresh_weights(belief, other);
+        belief->known[other] = belief->givenAway;
+        return;
+    }
+    double weight[9];
+    int known = belief->known[first];
+    memcpy(weight, belief->weight[first], sizeof(weight));
+    memcpy(belief->weight[first], belief->weight[second], sizeof(weight));
+    memcpy(belief->weight[second], weight, sizeof(weight));
+    belief->known[first] = belief->known[second];
+    belief->known[second] = known;
+}
+
+/*
+ * Updates belief for a thishappened, with held the card the seat
+ * believing holds once it has been dealt with (and after any replace it
+ * caused). The move's maker, if someone else, plays its card; then what
+ * the move shows is taken in: a missed guess, the result of a compare, a
+ * swap, and any card dropped.
+ */
+void update_belief(Belief* belief, const Event* event, char held) {
+    int player = event->player - 'A';
+    int target = event->target == '-' ? -1 : event->target - 'A';
+
+    if (player != belief->seat) {
+        play_card(belief, player, event->card - '0');
+    }
+    if (target >= 0 && target != player) {
+        switch (event->card) {
+            case '1':
+                //the target does not hold what was guessed
+                if (event->eliminated == '-' && event->guess != '-' &&
+                        target != belief->seat &&
+                        belief->known[target] == 0) {
+                    belief->weight[target][event->guess - '0'] = 0;
+                    scale_weights(belief, target);
+                }
+                break;
+            case '3':
+                if (event->dropper == '-') {
+                    tie_cards(belief, player, target, held);
+                } else {
+                    int loser = event->dropper - 'A';
+                    compare_cards(belief, loser == player ? target : player,
+                            loser);
+                }
+                break;
+            case '6':
+                swap_cards(belief, player, target);
+                break;
+        }
+    }
+    if (event->dropper != '-' && event->dropped != '-' &&
+            event->dropper - 'A' != belief->seat) {
+        drop_card(belief, event->dropper - 'A', event->dropped - '0');
+    }
+}
+
+/*
+ * Returns the chance that seat holds card.
+ */
+double card_chance(const Belief* belief, int seat, char card) {
+    const double* weight = belief->weight[seat];
+    int c = card - '0';
+    double total = 0;
+
+    if (belief->known[seat] != 0) {
+        return belief->known[seat] == c;
+    }
+    for (int d = 1; d <= 8; d++) {
+        total += weight[d] * belief->remaining[d];
+    }
+    return total > 0 ? weight[c] * belief->remaining[c] / total : 0;
+}
+
+/*
+ * Returns the card seat most likely holds of those from lowest up (the
+ * higher card of two as likely), or '-' if it can hold none of them.
+ */
+char likeliest_card(const Belief* belief, int seat, char lowest) {
+    const double* weight = belief->weight[seat];
+    int known = belief->known[seat];
+    double best = 0;
+    char card = '-';
+
+    if (known != 0) {
+        return known >= lowest - '0' ? known + '0' : '-';
+    }
+    for (int c = 8; c >= lowest - '0'; c--) {
+        double odds = weight[c] * belief->remaining[c];
+        if (odds > best) {
+            best = odds;
+            card = c + '0';
+        }
+    }
+    return card;
+}
@@ -0,0 +1,50 @@
+/*
+ * Beliefs about the cards of a round (libloveletter)
+ *
+ * What one seat can work out about the cards the others hold, kept up to
+ * date as thishappened messages come in. Each other seat has a weight per
+ * card, standing for how well that card fits all the seat has been seen
+ * to do; the chance that the seat holds a card is its weight times the
+ * copies of it still unseen, over the sum of those for every card.
+ * Keeping the unseen copies apart means a card turning up anywhere
+ * changes every seat's chances at once, with nothing to update.
+ *
+ * Every update costs a few passes over the 8 cards, however far into the
+ * round it comes, so a seat can ask for chances when it moves at no cost.
+ */
+
+#ifndef BELIEF_H
+#define BELIEF_H
+
+#include "strategy.h"
+
+/* The most seats a round has */
+#define BELIEF_SEATS 4
+
+/* What a seat believes of the others' cards. Cards are chars ('1' to
+ * '8') as in the messages, but indexes 1 to 8 into the arrays.
+ * - seat: the index of the seat believing
+ * - numPlayers: the number of players
+ * - remaining: copies of each card the seat has not seen yet
+ * - weight: for each seat, how well each card fits what it has done
+ * - known: the card each seat is known to hold, or 0; a known card has
+ *   been counted as seen
+ * - givenAway: the card held before the last replace
+ */
+typedef struct Belief {
+    int seat;
+    int numPlayers;
+    int remaining[9];
+    double weight[BELIEF_SEATS][9];
+    int known[BELIEF_SEATS];
+    int givenAway;
+} Belief;
+
+void reset_belief(Belief* belief, int numPlayers, char label);
+void belief_see_card(Belief* belief, char card);
+void belief_replace(Belief* belief, char held, char card);
+void update_belief(Belief* belief, const Event* event, char held);
+double card_chance(const Belief* belief, int seat, char card);
+char likeliest_card(const Belief* belief, int seat, char lowest);
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * The deckpack program
+ *
+ * Converts a deck file (or another binary corpus) into a binary deck
+ * corpus, which hub and tournament read in place of a deck file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "loveletter.h"
+
+/*Error exit statuses*/
+#define NORMAL_EXIT 0
+#define USAGE_ERROR 1
+#define ACCESS_ERROR 2
+#define DECK_ERROR 3
+#define WRITE_ERROR 4
+
+/*
+ * Exits the process with the given exitStatus.
+ */
+void exit_with(int exitStatus) {
+    switch(exitStatus) {
+        case 1:
+            fprintf(stderr, "Usage: deckpack deckfile corpusfile\n");
+            break;
+        case 2:
+            fprintf(stderr, "Unable to access deckfile\n");
+            break;
+        case 3:
+            fprintf(stderr, "Error reading deck\n");
+            break;
+        case 4:
+            fprintf(stderr, "Unable to write corpusfile\n");
+            break;
+        default:
+            break;
+    }
+    exit(exitStatus);
+}
+
+/*
+ * The main function
+ */
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        exit_with(USAGE_ERROR);
+    }
+    FILE* deckFile = fopen(argv[1], "r");
+    if (deckFile == NULL) {
+        exit_with(ACCESS_ERROR);
+    }
+    DeckCorpus* corpus = load_decks(deckFile);
+    fclose(deckFile);
+    if (corpus == NULL) {
+        exit_with(DECK_ERROR);
+    }
+    FILE* corpusFile = fopen(argv[2], "w");
+    if (corpusFile == NULL || !write_corpus(corpusFile, corpus) ||
+            fclose(corpusFile) != 0) {
+        exit_with(WRITE_ERROR);
+    }
+    free_corpus(corpus);
+    return NORMAL_EXIT;
+}
@@ -0,0 +1,545 @@
+/*
+ * Loading deck files (libloveletter)
+ *
+ * A deck file is one line of 16 cards per deck, each line ending in a
+ * newline (which the last may leave off, if it is not also the first),
+ * so deck i is always at byte LINE_SIZE * i. A binary corpus (see
+ * loveletter.h) has deck i at a fixed place too. Either way the file is
+ * mapped rather than read, and split between threads that each copy (or
+ * unrank) and check their share of the decks.
+ *
+ * A deck file can also be streamed, for a pipe that may never end: its
+ * lines are read a small buffer at a time as rounds want decks, so only
+ * the decks read ahead are ever held, unless the stream is to wrap
+ * around, when every deck read is kept to be dealt again.
+ *
+ * Every possible deck can be dealt in rank order without a file at all,
+ * each one unranked as it is wanted.
+ *
+ * A deck's rank is its place among all NUM_ORDERINGS decks in
+ * lexicographic order. Working along the deck, each card adds the number
+ * of orderings of the cards left that start with a smaller card; with n
+ * cards left, P orderings of them and c copies of card v among them,
+ * c * P / n of the orderings start with v.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "loveletter.h"
+
+/* The bytes of a line of a deck file */
+#define LINE_SIZE (DECK_SIZE + 1)
+/* The fewest decks worth giving a thread of their own */
+#define DECKS_PER_THREAD 65536
+/* The most threads loading a deck file */
+#define MAX_LOADERS 64
+/* Bytes read at a time from a deck file that cannot be mapped */
+#define READ_CHUNK 65536
+/* 32 bit FNV-1a */
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+/* The decks a stream reads ahead at most */
+#define STREAM_DECKS 64
+
+/* One thread's share of a deck file
+ * - text: the whole deck file
+ * - size: the bytes in text
+ * - binary: true if text is a binary corpus
+ * - decks: where the decks go
+ * - first: the first deck to load
+ * - last: one past the last deck to load
+ * - valid: set to false if any of the decks is not a deck
+ */
+typedef struct Loader {
+    const char* text;
+    size_t size;
+    bool binary;
+    Deck* decks;
+    long first;
+    long last;
+    bool valid;
+} Loader;
+
+/* Decks being read from a deck file as they are wanted
+ * - fd: the file they are read from
+ * - buffer: what has been read ahead of the decks dealt
+ * - start: the first byte of buffer not yet dealt
+ * - end: one past the last byte read into buffer
+ * - numRead: the number of decks read so far
+ * - ended: true once the end of the file has been read
+ * - failed: true once a line turned out not to be a deck
+ * - wrap: true to deal the decks again once the file ends
+ * - kept: every deck read, if wrap
+ * - capacity: the number of decks kept has room for
+ * - next: the next kept deck to deal, once the file has ended
+ */
+struct DeckStream {
+    int fd;
+    char buffer[STREAM_DECKS * LINE_SIZE];
+    int start;
+    int end;
+    long numRead;
+    bool ended;
+    bool failed;
+    bool wrap;
+    Deck* kept;
+    long capacity;
+    long next;
+};
+
+/*
+ * Returns the rank of deck, which must be a valid deck: its place among
+ * every ordering of the 16 cards, from 0 to NUM_ORDERINGS - 1.
+ */
+uint64_t rank_deck(const Deck* deck) {
+    int counts[8];
+    uint64_t orderings = NUM_ORDERINGS;
+    uint64_t rank = 0;
+
+    memcpy(counts, cardCopies + 1, sizeof(counts));
+    for (int n = DECK_SIZE; n > 0; n--) {
+        int card = deck->cards[DECK_SIZE - n] - '1';
+        //skip past every ordering that starts with a smaller card here
+        for (int v = 0; v < card; v++) {
+            rank += orderings * counts[v] / n;
+        }
+        orderings = orderings * counts[card] / n;
+        counts[card]--;
+    }
+    return rank;
+}
+
+/*
+ * Fills in deck as the deck of the given rank. Returns false if there is
+ * no such deck.
+ */
+bool unrank_deck(uint64_t rank, Deck* deck) {
+    int counts[8];
+    uint64_t orderings = NUM_ORDERINGS;
+
+    if (rank >= NUM_ORDERINGS) {
+        return false;
+    }
+    memcpy(counts, cardCopies + 1, sizeof(counts));
+    for (int n = DECK_SIZE; n > 0; n--) {
+        int v = 0;
+        uint64_t starting = orderings * counts[0] / n;
+        //find the card whose orderings the rank falls among
+        while (rank >= starting) {
+            rank -= starting;
+            v++;
+            starting = orderings * counts[v] / n;
+        }
+        deck->cards[DECK_SIZE - n] = v + '1';
+        orderings = starting;
+        counts[v]--;
+    }
+    return true;
+}
+
+/*
+ * Returns the FNV-1a checksum of the size bytes of data.
+ */
+static uint32_t checksum(const unsigned char* data, size_t size) {
+    uint32_t hash = FNV_BASIS;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/*
+ * Reads the little endian number in the size bytes of data.
+ */
+static uint64_t read_number(const unsigned char* data, int size) {
+    uint64_t number = 0;
+
+    for (int i = size - 1; i >= 0; i--) {
+        number = number << 8 | data[i];
+    }
+    return number;
+}
+
+/*
+ * Writes number into the size bytes of data, little endian.
+ */
+static void write_number(unsigned char* data, uint64_t number, int size) {
+    for (int i = 0; i < size; i++) {
+        data[i] = number >> (8 * i);
+    }
+}
+
+/*
+ * Unranks the decks of a Loader of a binary corpus.
+ */
+static void unrank_share(Loader* loader) {
+    const unsigned char* ranks = (const unsigned char*)loader->text +
+            CORPUS_HEADER;
+
+    for (long i = loader->first; i < loader->last; i++) {
+        if (!unrank_deck(read_number(ranks + CORPUS_DECK_SIZE * i,
+                CORPUS_DECK_SIZE), &loader->decks[i])) {
+            loader->valid = false;
+            return;
+        }
+    }
+}
+
+/*
+ * Copies and checks the decks of a Loader.
+ */
+static void* load_share(void* arg) {
+    Loader* loader = arg;
+
+    if (loader->binary) {
+        unrank_share(loader);
+        return NULL;
+    }
+    for (long i = loader->first; i < loader->last; i++) {
+        const char* line = loader->text + LINE_SIZE * i;
+        //only the last line can end without a newline
+        size_t end = LINE_SIZE * i + DECK_SIZE;
+        if ((end < loader->size && line[DECK_SIZE] != '\n') ||
+                !check_sum(line)) {
+            loader->valid = false;
+            return NULL;
+        }
+        memcpy(loader->decks[i].cards, line, DECK_SIZE);
+    }
+    return NULL;
+}
+
+/*
+ * Works out how many decks are in the size bytes of text, storing
+ * whether it is a binary corpus in binary. Returns 0 if text is neither
+ * a deck file nor a binary corpus.
+ */
+static long count_decks(const char* text, size_t size, bool* binary) {
+    const unsigned char* header = (const unsigned char*)text;
+
+    *binary = size >= CORPUS_HEADER &&
+            memcmp(text, CORPUS_MAGIC, 4) == 0;
+    if (*binary) {
+        uint64_t numDecks = read_number(header + 8, 8);
+        if (header[4] != CORPUS_VERSION ||
+                header[5] != CORPUS_DECK_SIZE ||
+                numDecks > (size - CORPUS_HEADER) / CORPUS_DECK_SIZE ||
+                size != CORPUS_HEADER + numDecks * CORPUS_DECK_SIZE ||
+                read_number(header + 16, 4) != checksum(header +
+                CORPUS_HEADER, size - CORPUS_HEADER)) {
+            return 0;
+        }
+        return numDecks;
+    }
+    //the first line always needs its newline, even if it is the last
+    if (size < LINE_SIZE || (size % LINE_SIZE != 0 &&
+            size % LINE_SIZE != DECK_SIZE)) {
+        return 0;
+    }
+    return (size + 1) / LINE_SIZE;
+}
+
+/*
+ * Makes a corpus of the decks in the size bytes of text, on as many
+ * threads as it is worth. Returns NULL if text is not a deck file or a
+ * binary corpus.
+ */
+static DeckCorpus* parse_decks(const char* text, size_t size) {
+    Loader loaders[MAX_LOADERS];
+    pthread_t threads[MAX_LOADERS];
+    bool binary;
+    long numDecks = count_decks(text, size, &binary);
+    bool valid = true;
+
+    if (numDecks == 0) {
+        return NULL;
+    }
+    DeckCorpus* corpus = calloc(1, sizeof(DeckCorpus));
+    corpus->decks = malloc(sizeof(Deck) * numDecks);
+    corpus->numDecks = numDecks;
+
+    long numLoaders = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numLoaders > numDecks / DECKS_PER_THREAD) {
+        numLoaders = numDecks / DECKS_PER_THREAD;
+    }
+    if (numLoaders > MAX_LOADERS) {
+        numLoaders = MAX_LOADERS;
+    } else if (numLoaders < 1) {
+        numLoaders = 1;
+    }
+    for (int i = 0; i < numLoaders; i++) {
+        Loader* loader = &loaders[i];
+        loader->text = text;
+        loader->size = size;
+        loader->binary = binary;
+        loader->decks = corpus->decks;
+        loader->first = numDecks * i / numLoaders;
+        loader->last = numDecks * (i + 1) / numLoaders;
+        loader->valid = true;
+    }
+    //the last share is this thread's own
+    for (int i = 0; i < numLoaders - 1; i++) {
+        pthread_create(&threads[i], NULL, load_share, &loaders[i]);
+    }
+    load_share(&loaders[numLoaders - 1]);
+    for (int i = 0; i < numLoaders; i++) {
+        if (i < numLoaders - 1) {
+            pthread_join(threads[i], NULL);
+        }
+        valid = valid && loaders[i].valid;
+    }
+    if (!valid) {
+        free_corpus(corpus);
+        return NULL;
+    }
+    return corpus;
+}
+
+/*
+ * Reads all of a deck file that cannot be mapped (such as a pipe) into
+ * memory, storing its size in size.
+ */
+static char* read_all(FILE* deckFile, size_t* size) {
+    size_t capacity = READ_CHUNK;
+    char* text = malloc(capacity);
+    size_t got;
+
+    *size = 0;
+    while ((got = fread(text + *size, 1, capacity - *size, deckFile)) > 0) {
+        *size += got;
+        if (*size == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    return text;
+}
+
+/*
+ * Loads every deck of deckFile (a deck file or a binary corpus) into a
+ * corpus, in file order. Returns NULL upon an incorrect line of the
+ * file, a damaged corpus, or an empty file.
+ */
+DeckCorpus* load_decks(FILE* deckFile) {
+    DeckCorpus* corpus;
+    struct stat info;
+    int fd = fileno(deckFile);
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            info.st_size == 0) {
+        size_t size;
+        char* text = read_all(deckFile, &size);
+        corpus = parse_decks(text, size);
+        free(text);
+        return corpus;
+    }
+    char* text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(text, info.st_size, MADV_WILLNEED);
+    corpus = parse_decks(text, info.st_size);
+    munmap(text, info.st_size);
+    return corpus;
+}
+
+/*
+ * Writes corpus to corpusFile as a binary corpus. Returns false if it
+ * could not all be written.
+ */
+bool write_corpus(FILE* corpusFile, const DeckCorpus* corpus) {
+    unsigned char header[CORPUS_HEADER] = {CORPUS_MAGIC[0],
+            CORPUS_MAGIC[1], CORPUS_MAGIC[2], CORPUS_MAGIC[3],
+            CORPUS_VERSION, CORPUS_DECK_SIZE};
+    size_t size = CORPUS_DECK_SIZE * corpus->numDecks;
+    unsigned char* ranks = malloc(size);
+
+    for (long i = 0; i < corpus->numDecks; i++) {
+        Deck deck;
+        get_deck(corpus, i, &deck);
+        write_number(ranks + CORPUS_DECK_SIZE * i, rank_deck(&deck),
+                CORPUS_DECK_SIZE);
+    }
+    write_number(header + 8, corpus->numDecks, 8);
+    write_number(header + 16, checksum(ranks, size), 4);
+    bool written = fwrite(header, 1, CORPUS_HEADER, corpusFile) ==
+            CORPUS_HEADER && fwrite(ranks, 1, size, corpusFile) == size;
+    free(ranks);
+    return written;
+}
+
+/*
+ * Makes a corpus of numDecks decks generated from seed, which takes no
+ * memory for the decks themselves: deck i is always the same deck for
+ * the same seed.
+ */
+DeckCorpus* generate_decks(uint64_t seed, long numDecks) {
+    DeckCorpus* corpus = calloc(1, sizeof(DeckCorpus));
+
+    corpus->numDecks = numDecks;
+    corpus->seed = seed;
+    return corpus;
+}
+
+/*
+ * Makes a corpus of the decks of the deck file open on fd, read only as
+ * they are wanted. Once the file ends, its decks are dealt again from
+ * the first if wrap, and otherwise there are no more.
+ */
+DeckCorpus* stream_decks(int fd, bool wrap) {
+    DeckCorpus* corpus = calloc(1, sizeof(DeckCorpus));
+
+    corpus->numDecks = LONG_MAX;
+    corpus->stream = calloc(1, sizeof(DeckStream));
+    corpus->stream->fd = fd;
+    corpus->stream->wrap = wrap;
+    return corpus;
+}
+
+/*
+ * Makes a corpus of every possible deck, deck i being the deck of rank i.
+ */
+DeckCorpus* enumerate_decks(void) {
+    DeckCorpus* corpus = calloc(1, sizeof(DeckCorpus));
+
+    corpus->numDecks = NUM_ORDERINGS;
+    corpus->ranked = true;
+    return corpus;
+}
+
+/*
+ * Reads the next line of stream into deck, reading more of the file
+ * (as much as is there, up to a buffer full) if a whole line is not
+ * buffered. Returns false at the end of the file or at a line that is
+ * not a deck, which fails the stream.
+ */
+static bool read_stream(DeckStream* stream, Deck* deck) {
+    while (stream->end - stream->start < LINE_SIZE && !stream->ended) {
+        memmove(stream->buffer, stream->buffer + stream->start,
+                stream->end - stream->start);
+        stream->end -= stream->start;
+        stream->start = 0;
+        ssize_t got = read(stream->fd, stream->buffer + stream->end,
+                sizeof(stream->buffer) - stream->end);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            stream->ended = true;
+        } else {
+            stream->end += got;
+        }
+    }
+    int left = stream->end - stream->start;
+    const char* line = stream->buffer + stream->start;
+    if (left == 0) {
+        return false;
+    }
+    //the last line may leave off its newline, unless it is also the first
+    if (left < LINE_SIZE ? left != DECK_SIZE || stream->numRead == 0 :
+            line[DECK_SIZE] != '\n') {
+        stream->failed = true;
+        return false;
+    }
+    if (!check_sum(line)) {
+        stream->failed = true;
+        return false;
+    }
+    memcpy(deck->cards, line, DECK_SIZE);
+    stream->start += left < LINE_SIZE ? DECK_SIZE : LINE_SIZE;
+    stream->numRead++;
+    return true;
+}
+
+/*
+ * Deals the next deck of stream into deck, keeping it to deal again if
+ * the stream wraps. Returns false if there are no more decks.
+ */
+static bool next_streamed(DeckStream* stream, Deck* deck) {
+    if (!stream->failed && read_stream(stream, deck)) {
+        if (stream->wrap) {
+            if (stream->numRead > stream->capacity) {
+                stream->capacity = stream->capacity * 2 + STREAM_DECKS;
+                stream->kept = realloc(stream->kept,
+                        sizeof(Deck) * stream->capacity);
+            }
+            stream->kept[stream->numRead - 1] = *deck;
+        }
+        return true;
+    }
+    if (stream->failed || !stream->wrap || stream->numRead == 0) {
+        return false;
+    }
+    *deck = stream->kept[stream->next];
+    stream->next = (stream->next + 1) % stream->numRead;
+    return true;
+}
+
+/*
+ * Returns the next number of a splitmix64 generator at state.
+ */
+static uint64_t splitmix(uint64_t* state) {
+    uint64_t z = (*state += GOLDEN);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Copies deck index of corpus into deck, unranking it if corpus is every
+ * deck or making it up if corpus is generated: a Fisher-Yates shuffle of
+ * the 16 cards, with the generator started at a place only this deck
+ * uses. Every shuffle is a valid deck. A stream has no index; it deals
+ * its next deck each time (and is not to be shared between threads).
+ * Returns false if there is no deck, which only happens to a stream.
+ */
+bool get_deck(const DeckCorpus* corpus, long index, Deck* deck) {
+    static const char sorted[DECK_SIZE + 1] = "1111122334455678";
+
+    if (corpus->decks != NULL) {
+        *deck = corpus->decks[index];
+        return true;
+    } else if (corpus->stream != NULL) {
+        return next_streamed(corpus->stream, deck);
+    } else if (corpus->ranked) {
+        return unrank_deck(index, deck);
+    }
+    uint64_t state = corpus->seed + (uint64_t)index * DECK_SIZE * GOLDEN;
+    uint64_t random = 0;
+    memcpy(deck->cards, sorted, DECK_SIZE);
+    for (int i = DECK_SIZE - 1; i > 0; i--) {
+        //each 64 random bits make two picks
+        if (i % 2 == 1) {
+            random = splitmix(&state);
+        }
+        uint32_t bits = random;
+        random >>= 32;
+        int j = ((uint64_t)bits * (i + 1)) >> 32;
+        char card = deck->cards[i];
+        deck->cards[i] = deck->cards[j];
+        deck->cards[j] = card;
+    }
+    return true;
+}
+
+/*
+ * Frees a corpus made by load_decks, generate_decks, stream_decks or
+ * enumerate_decks (leaving the stream's file open).
+ */
+void free_corpus(DeckCorpus* corpus) {
+    if (corpus->stream != NULL) {
+        free(corpus->stream->kept);
+        free(corpus->stream);
+    }
+    free(corpus->decks);
+    free(corpus);
+}
@@ -0,0 +1,129 @@
+/*
+ * Reading newline framed protocol messages (libloveletter)
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "frame.h"
+#include "shm.h"
+
+/*
+ * Sets up framer to read from fd.
+ */
+void init_framer(Framer* framer, int fd) {
+    framer->fd = fd;
+    framer->start = 0;
+    framer->end = 0;
+    framer->eof = false;
+    framer->ring = NULL;
+}
+
+/*
+ * Makes one read() of whatever is available into framer (blocking only
+ * if fd blocks). Returns the number of bytes read, 0 at EOF (which is
+ * remembered), or -1 with errno set, as read() does. A read error other
+ * than EAGAIN or EINTR is treated as EOF. A framer on a ring never
+ * blocks, and only reaches EOF when its owner says so.
+ */
+ssize_t read_frames(Framer* framer) {
+    ssize_t got;
+
+    if (framer->eof) {
+        return 0;
+    }
+    //move what is left to the front once there is no room at the end
+    if (framer->end == FRAME_BUFFER) {
+        framer->end -= framer->start;
+        memmove(framer->buffer, framer->buffer + framer->start,
+                framer->end);
+        framer->start = 0;
+        if (framer->end == FRAME_BUFFER) {
+            errno = ENOBUFS;
+            return -1;
+        }
+    }
+    if (framer->ring != NULL) {
+        got = ring_read(framer->ring, framer->buffer + framer->end,
+                FRAME_BUFFER - framer->end);
+        if (got == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+        framer->end += got;
+        return got;
+    }
+    got = read(framer->fd, framer->buffer + framer->end,
+            FRAME_BUFFER - framer->end);
+    if (got > 0) {
+        framer->end += got;
+    } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+        framer->eof = true;
+        got = 0;
+    }
+    return got;
+}
+
+/*
+ * Finds the next message in framer, which may be at most limit chars
+ * before its newline. On success message points at it in the buffer,
+ * with the newline replaced by '\0', and its length is returned. It
+ * stays valid until the next read_frames.
+ * Otherwise returns FRAME_TOO_LONG (message points at the unterminated
+ * start of it), FRAME_EOF if no whole message will ever come, or
+ * FRAME_WAIT if more must be read first.
+ */
+int next_frame(Framer* framer, int limit, char** message) {
+    char* start = framer->buffer + framer->start;
+    int available = framer->end - framer->start;
+    int search = available < limit + 1 ? available : limit + 1;
+    char* newline = memchr(start, '\n', search);
+
+    *message = start;
+    if (newline != NULL) {
+        *newline = '\0';
+        framer->start += newline - start + 1;
+        //start over at the front of the buffer once it is all used
+        if (framer->start == framer->end) {
+            framer->start = 0;
+            framer->end = 0;
+        }
+        return newline - start;
+    } else if (available > limit) {
+        return FRAME_TOO_LONG;
+    } else if (framer->eof) {
+        return FRAME_EOF;
+    } else {
+        return FRAME_WAIT;
+    }
+}
+
+/*
+ * Returns the next unused byte in framer without using it, or
+ * FRAME_EOF or FRAME_WAIT if there is none.
+ */
+int peek_byte(const Framer* framer) {
+    if (framer->start < framer->end) {
+        return (unsigned char)framer->buffer[framer->start];
+    }
+    return framer->eof ? FRAME_EOF : FRAME_WAIT;
+}
+
+/*
+ * Finds the next fixed size record in framer, pointing record at it in
+ * the buffer and returning size. It stays valid until the next
+ * read_frames. Otherwise returns FRAME_EOF if the whole record will
+ * never come, or FRAME_WAIT if more must be read first.
+ */
+int next_record(Framer* framer, int size, char** record) {
+    *record = framer->buffer + framer->start;
+    if (framer->end - framer->start >= size) {
+        framer->start += size;
+        if (framer->start == framer->end) {
+            framer->start = 0;
+            framer->end = 0;
+        }
+        return size;
+    }
+    return framer->eof ? FRAME_EOF : FRAME_WAIT;
+}
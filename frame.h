@@ -0,0 +1,46 @@
+/*
+ * Reading newline framed protocol messages (libloveletter)
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Bytes held for messages that have been read but not yet used */
+#define FRAME_BUFFER 4096
+/* Results of next_frame, peek_byte and next_record other than a message
+ * length or byte */
+#define FRAME_WAIT -1
+#define FRAME_TOO_LONG -2
+#define FRAME_EOF -3
+
+/* A reader of newline terminated messages straight from a file
+ * descriptor (or from a shared memory ring, see shm.h). Bytes read but
+ * not yet framed sit between start and end of buffer. When end reaches
+ * the end of the buffer the (short) unused bytes are moved back to the
+ * front, so every message is contiguous and can be handed out in place.
+ * - fd: the file descriptor to read from
+ * - start: the first unused byte
+ * - end: one past the last byte read
+ * - eof: true once the writer has closed the file
+ * - ring: the ring to read from instead of fd, or NULL
+ * - buffer: the bytes read
+ */
+typedef struct Framer {
+    int fd;
+    int start;
+    int end;
+    bool eof;
+    struct Ring* ring;
+    char buffer[FRAME_BUFFER];
+} Framer;
+
+void init_framer(Framer* framer, int fd);
+ssize_t read_frames(Framer* framer);
+int next_frame(Framer* framer, int limit, char** message);
+int peek_byte(const Framer* framer);
+int next_record(Framer* framer, int size, char** record);
+
+#endif
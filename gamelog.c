@@ -0,0 +1,236 @@
+/*
+ * Game event logs and commentary (libloveletter)
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "gamelog.h"
+
+/* Bytes before the first record of a log */
+#define LOG_HEADER 8
+/* Bytes of records buffered before a write */
+#define LOG_BUFFER 65536
+
+/*
+ * Creates the log file path for a hub running numTables tables, with
+ * its header written and a big buffer. Returns NULL if it cannot be
+ * created.
+ */
+FILE* create_log(const char* path, int numTables) {
+    unsigned char header[LOG_HEADER] = {LOG_MAGIC[0], LOG_MAGIC[1],
+            LOG_MAGIC[2], LOG_MAGIC[3], LOG_VERSION, LOG_RECORD_SIZE,
+            numTables & 0xff, numTables >> 8};
+    FILE* log = fopen(path, "w");
+
+    if (log == NULL) {
+        return NULL;
+    }
+    setvbuf(log, NULL, _IOFBF, LOG_BUFFER);
+    fwrite(header, 1, LOG_HEADER, log);
+    return log;
+}
+
+/*
+ * Adds record to log.
+ */
+void write_log(FILE* log, const LogRecord* record) {
+    fwrite(record, LOG_RECORD_SIZE, 1, log);
+}
+
+/*
+ * Reads the header of log, storing the number of tables it has records
+ * for in numTables. Returns false if log is not a log this can read.
+ */
+bool read_log_header(FILE* log, int* numTables) {
+    unsigned char header[LOG_HEADER];
+
+    if (fread(header, 1, LOG_HEADER, log) != LOG_HEADER ||
+            memcmp(header, LOG_MAGIC, 4) != 0 ||
+            header[4] != LOG_VERSION || header[5] != LOG_RECORD_SIZE) {
+        return false;
+    }
+    *numTables = header[6] | header[7] << 8;
+    return true;
+}
+
+/*
+ * Reads the next record of log into record. Returns false at the end of
+ * the log (or at a record cut short).
+ */
+bool read_log(FILE* log, LogRecord* record) {
+    return fread(record, LOG_RECORD_SIZE, 1, log) == 1;
+}
+
+/*
+ * Returns the card the commentary says was dropped in event, which
+ * game has just had applied to it.
+ */
+char shown_dropped(const Game* game, const Event* event) {
+    //a 3 leaves the dropped card in the loser's holding
+    if (event->card == '3' && event->dropper != '-') {
+        return game->players[event->dropper - SHIFT].holding;
+    }
+    return event->dropped;
+}
+
+/*
+ * Finds who won the round just played in game: everyone still in the
+ * round holding the high card, stored as bit n for seat n in winners.
+ * Returns the high card.
+ */
+char find_round_winners(const Game* game, int* winners) {
+    char high = '0';
+
+    for (int j = 0; j < game->numPlayers; j++) {
+        if (!(game->players[j].outOfRound) &&
+                game->players[j].holding >= high) {
+            high = game->players[j].holding;
+        }
+    }
+    *winners = 0;
+    for (int k = 0; k < game->numPlayers; k++) {
+        if (!(game->players[k].outOfRound) &&
+                game->players[k].holding == high) {
+            *winners |= 1 << k;
+        }
+    }
+    return high;
+}
+
+/*
+ * Prints the commentary for a move, for example:
+ * Player A discarded 5 aimed at B. This forced B to discard 3.
+ * dropped is the card the dropper is said to discard.
+ */
+static void print_move(FILE* out, const Event* event, char dropped) {
+    char player = event->player;
+    char target = event->target;
+    char guess = event->guess;
+
+    if (target == '-') {
+        //no one was aimed at, at most the player went out
+        fprintf(out, "Player %c discarded %c.", player, event->card);
+        if (event->eliminated != '-') {
+            fprintf(out, " %c was out.", event->eliminated);
+        }
+    } else if (event->card == '1' && guess != '-') {
+        fprintf(out, "Player %c discarded 1 aimed at %c guessing %c.",
+                player, target, guess);
+    } else {
+        fprintf(out, "Player %c discarded %c aimed at %c.", player,
+                event->card, target);
+    }
+
+    //The effect on the player who lost their card (if any)
+    if (event->dropper != '-') {
+        fprintf(out, " This forced %c to discard %c.", event->dropper,
+                dropped);
+        if (event->eliminated != '-') {
+            fprintf(out, " %c was out.", event->eliminated);
+        }
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * Prints who won a round, holding the high card: the seats set in
+ * winners.
+ */
+static void print_round_winners(FILE* out, char high, int winners,
+        int numPlayers) {
+    fprintf(out, "Round winner(s) holding %c:", high);
+    for (int k = 0; k < numPlayers; k++) {
+        if (winners & (1 << k)) {
+            fprintf(out, " %c", k + SHIFT);
+        }
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * Prints who won a game with scores.
+ */
+static void print_winners(FILE* out, const int* scores, int numPlayers) {
+    fprintf(out, "Winner(s):");
+    for (int i = 0; i < numPlayers; i++) {
+        if (scores[i] == WINNING_SCORE) {
+            fprintf(out, " %c", i + SHIFT);
+        }
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * Sets up commentary for numTables tables, going to out.
+ */
+void init_commentary(Commentary* commentary, FILE* out, int numTables) {
+    commentary->out = out;
+    commentary->numTables = numTables;
+    commentary->tables = calloc(numTables, sizeof(CommentaryTable));
+    for (int t = 0; t < numTables; t++) {
+        CommentaryTable* table = &commentary->tables[t];
+        table->out = numTables == 1 ? out :
+                open_memstream(&table->buffer, &table->size);
+    }
+}
+
+/*
+ * Tells what record says happened in the commentary (rounds starting
+ * are not told). Returns false if record does not fit the tables.
+ */
+bool comment_record(Commentary* commentary, const LogRecord* record) {
+    int scores[MAX_PLAYERS];
+
+    if (record->table >= commentary->numTables) {
+        return false;
+    }
+    CommentaryTable* table = &commentary->tables[record->table];
+    if (record->type == LOG_GAME) {
+        table->numPlayers = record->data[0];
+        return table->numPlayers >= MIN_PLAYERS &&
+                table->numPlayers <= MAX_PLAYERS;
+    } else if (table->numPlayers == 0) {
+        return false;
+    }
+    switch (record->type) {
+        case LOG_MOVE: {
+            const char* logged = record->data + LOG_MOVE_EVENT;
+            Event event = {logged[0], logged[1], logged[2], logged[3],
+                    logged[4], logged[5], logged[6]};
+            print_move(table->out, &event, record->data[LOG_MOVE_SHOWN]);
+            break;
+        }
+        case LOG_SCORES:
+            print_round_winners(table->out, record->data[LOG_SCORES_HIGH],
+                    record->data[LOG_SCORES_WINNERS], table->numPlayers);
+            break;
+        case LOG_WINNER:
+            for (int i = 0; i < table->numPlayers; i++) {
+                scores[i] = record->data[i];
+            }
+            print_winners(table->out, scores, table->numPlayers);
+            if (table->out != commentary->out) {
+                fclose(table->out);
+                fwrite(table->buffer, 1, table->size, commentary->out);
+                free(table->buffer);
+                table->out = open_memstream(&table->buffer, &table->size);
+            }
+            break;
+    }
+    return true;
+}
+
+/*
+ * Releases what commentary holds, dropping any unfinished games.
+ */
+void free_commentary(Commentary* commentary) {
+    for (int t = 0; t < commentary->numTables; t++) {
+        CommentaryTable* table = &commentary->tables[t];
+        if (table->out != commentary->out) {
+            fclose(table->out);
+            free(table->buffer);
+        }
+    }
+    free(commentary->tables);
+}
@@ -0,0 +1,106 @@
+/*
+ * Game event logs and commentary (libloveletter)
+ *
+ * The commentary the hub prints for a game is told here from the same
+ * records a log holds, so that a game reads the same whether the hub
+ * tells it as it goes, in a writer thread, or replay tells it from a
+ * log. A log is a header (LOG_MAGIC, then a byte each for the version
+ * and the size of a record, then the number of tables as 2 bytes)
+ * followed by fixed size LogRecords in the order they happened, in the
+ * byte order of the machine that wrote them.
+ *
+ * Records are all LOG_RECORD_SIZE bytes; what data holds depends on the
+ * type (cards, players and guesses are protocol chars):
+ * - game: a game starts at the table, data[0] is the number of players
+ * - round: a round starts, data is the deck it is played with
+ * - move: seat made a move, data is the move sent, the Event it caused
+ *   (player, card, target, guess, dropper, dropped, eliminated) and the
+ *   card the commentary says was dropped
+ * - scores: the round is over, data is the high card, the round winners
+ *   (bit n for seat n) and the scores
+ * - winner: the game is over, data is the scores
+ */
+
+#ifndef GAMELOG_H
+#define GAMELOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "loveletter.h"
+
+#define LOG_MAGIC "LLEV"
+#define LOG_VERSION 1
+#define LOG_RECORD_SIZE 28
+/* Record types */
+#define LOG_GAME 1
+#define LOG_ROUND 2
+#define LOG_MOVE 3
+#define LOG_SCORES 4
+#define LOG_WINNER 5
+/* Where the fields of a move are in data */
+#define LOG_MOVE_SENT 0
+#define LOG_MOVE_EVENT 3
+#define LOG_MOVE_SHOWN 10
+/* Where the fields of scores are in data */
+#define LOG_SCORES_HIGH 0
+#define LOG_SCORES_WINNERS 1
+#define LOG_SCORES_SCORES 2
+
+/* One thing that happened at a table
+ * - type: what happened (LOG_GAME onwards)
+ * - seat: the seat that moved, for a move
+ * - table: the table it happened at
+ * - game: the number of games the table had finished
+ * - round: the number of rounds of the game finished
+ * - data: the details, by type
+ */
+typedef struct LogRecord {
+    uint8_t type;
+    uint8_t seat;
+    uint16_t table;
+    uint32_t game;
+    uint32_t round;
+    char data[DECK_SIZE];
+} LogRecord;
+
+/* One table's commentary
+ * - numPlayers: the number of players in its game, or 0 before the first
+ * - out: where it goes (the commentary's out, or a buffer for the game)
+ * - buffer: the commentary buffered for the current game (if any)
+ * - size: the size of buffer
+ */
+typedef struct CommentaryTable {
+    int numPlayers;
+    FILE* out;
+    char* buffer;
+    size_t size;
+} CommentaryTable;
+
+/* The commentary of every table, told from their records. A lone table
+ * speaks straight to out; with more, each game goes out in one piece
+ * once it is won, so games never interleave.
+ * - out: where the commentary goes
+ * - numTables: the number of tables
+ * - tables: each table's commentary
+ */
+typedef struct Commentary {
+    FILE* out;
+    int numTables;
+    CommentaryTable* tables;
+} Commentary;
+
+/* Logs */
+FILE* create_log(const char* path, int numTables);
+void write_log(FILE* log, const LogRecord* record);
+bool read_log_header(FILE* log, int* numTables);
+bool read_log(FILE* log, LogRecord* record);
+
+/* Commentary */
+char shown_dropped(const Game* game, const Event* event);
+char find_round_winners(const Game* game, int* winners);
+void init_commentary(Commentary* commentary, FILE* out, int numTables);
+bool comment_record(Commentary* commentary, const LogRecord* record);
+void free_commentary(Commentary* commentary);
+
+#endif
@@ -1,7 +1,13 @@
 /*
  * The hub program
+ *
+ * A thin driver around the rules engine in libloveletter: it runs games
+ * between child processes, turning engine Outcomes into protocol
+ * messages and commentary. Any number of tables of players can play at
+ * once; an epoll event loop moves on whichever table has a reply.
  */ 
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,8 +15,23 @@
 #include <signal.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sched.h>
+#include <pthread.h>
+#include <getopt.h>
+#include "loveletter.h"
+#include "frame.h"
+#include "wire.h"
+#include "shm.h"
+#include "gamelog.h"
+#include "latency.h"
 
 /*Error exit statuses*/
 #define NORMAL_EXIT 0
@@ -21,61 +42,139 @@
 #define QUIT_ERROR 5
 #define MESSAGE_ERROR 6
 #define SIGINT_ERROR 7
+#define LOG_ERROR 8
+#define STATS_ERROR 9
 /* Read and write defines */
 #define READ 0
 #define WRITE 1
-/*A common shift for chars to ints and vice versa*/
-#define SHIFT 65
-
-/* A generic Deck struct to contain a list of 16 deck cards 
- * - cards: a list of 16 cards
- * - pos: the pos of the next card to get in the deck
- * - nextDeck: the next deck after this deck
- * */
-typedef struct Deck {
-    char cards[16]; 
-    int pos; 
-    struct Deck* nextDeck;
-} Deck;
-
-/* A stream struct, containing both a read and write file pointer
- * - write: the file pointer to write to for this stream
- * - read: the file pointer to read from for this stream
+/* The length of a reply to yourturn (c1pc2) */
+#define MOVE_LENGTH 3
+/* Most epoll events handled per wakeup */
+#define MAX_EVENTS 256
+/* Output queued between flushes: bytes and writes kept for one player,
+ * and bytes of messages shared by every player at a table. A flush is
+ * well under PIPE_BUF, so each writev goes out whole. */
+#define OUT_BUFFER 128
+#define MAX_PARTS 16
+#define SHARED_BUFFER 128
+/* Longest sleep (ms) on the shared memory bell before looking at the
+ * pipes, when every player is on shared memory and when some are not */
+#define SHM_TIMEOUT 10
+#define MIXED_TIMEOUT 1
+/* How the commentary is told: as each thing happens, by a writer thread
+ * from queued records, or not at all */
+#define COMMENTARY_SYNC 0
+#define COMMENTARY_ASYNC 1
+#define COMMENTARY_QUIET 2
+/* Records the writer thread can fall behind by (a power of 2) */
+#define QUEUE_SIZE 65536
+/* Longest sleep (ms) of the writer thread before it looks for records */
+#define WRITER_TIMEOUT 10
+/* Bytes of commentary the writer thread buffers between writes */
+#define WRITER_BUFFER 65536
+/* Keep the fields written by different threads on their own lines */
+#define CACHE_LINE 64
+/* Codes of the options with only long names */
+#define OPTION_SEED 256
+#define OPTION_DECKS 257
+#define OPTION_STREAM 258
+#define OPTION_WRAP 259
+/* Nanoseconds between writes of the stats file while games go on */
+#define STATS_PERIOD 1000000000ULL
+
+/* A stream struct, containing both a write file descriptor and a reader
+ * - write: the file descriptor to write to for this stream
+ * - read: the (non-blocking) framer to read replies from, whatever the
+ *   player has sent is kept in it until a reply is wanted
+ * - binary: true if the player speaks the binary protocol
+ * - parts: the output queued for the next flush, in sending order
+ * - numParts: the number of parts queued
+ * - own: the bytes of queued messages meant for this player alone
+ * - ownLength: the number of bytes used in own
+ * - channel: the player's shared memory channel, or NULL if it is on
+ *   the pipes
+ * - strategy: the plugin playing this seat in the hub's own process, or
+ *   NULL if a child process plays it
+ * - state: the strategy's state for the seat
+ * - move: the strategy's answer to the last yourturn
  */
 typedef struct Stream {
-    FILE* write; 
-    FILE* read;
+    int write; 
+    Framer read;
+    bool binary;
+    Channel* channel;
+    const Strategy* strategy;
+    void* state;
+    char move[MOVE_LENGTH];
+    struct iovec parts[MAX_PARTS];
+    int numParts;
+    char own[OUT_BUFFER];
+    int ownLength;
 } Stream;
 
-/* A player struct 
- * - outOfRound: boolean for out of round status
- * - label: the player label
- * - holding: what the player is holding
- * - protected: boolean for the protection status
- */
-typedef struct Player {
-    bool outOfRound;
-    char label; 
-    char holding; 
-    bool protected; 
-} Player;
-
-/* A game struct containing all the information about this game
- * - round: the current round
- * - numPlayers: the number of players (child processes)
- * - deck: the game deck (for this round)
- * - scores: an array of scores for each player
+/* The hub's side of a game (one table of players)
+ * - game: the rules engine state for the game
  * - pipes: a list of streams for 2 way communication with children
- * - players: a list of players in the game
+ * - pids: the process IDs of this table's children
+ * - waiting: the player whose reply is wanted, or -1
+ * - inRound: true while a round is being played
+ * - gamesPlayed: the number of games this table has finished
+ * - offerBinary: true if players are offered the binary protocol
+ * - move: the text form of the last binary reply
+ * - shared: the bytes of queued messages sent to every player
+ * - sharedLength: the number of bytes used in shared
+ * - firstChannel: the index of the table's first shared memory channel
+ * - table: the index of the table
+ * - askedAt: when the player waited on was sent yourturn (if timing)
  */
-typedef struct Game {
-    int round;
-    int numPlayers; 
-    struct Deck* deck;
-    int* scores; 
+typedef struct Hub {
+    Game game;
     struct Stream* pipes; 
-    struct Player* players; 
-} Game;
+    int* pids;
+    int waiting;
+    bool inRound;
+    long gamesPlayed;
+    bool offerBinary;
+    char move[MOVE_LENGTH];
+    char shared[SHARED_BUFFER];
+    int sharedLength;
+    int firstChannel;
+    int table;
+    uint64_t askedAt;
+} Hub;
+
+/* Every game the hub is running, driven by an epoll event loop
+ * - hubs: the tables being played
+ * - numHubs: the number of tables
+ * - numGames: the number of games to play in total
+ * - firstDeck: the index of the deck the first table starts on
+ * - gamesStarted: the number of games started so far
+ * - running: the number of tables still playing
+ * - epoll: the epoll instance watching every player's pipe
+ * - offerBinary: true if players are offered the binary protocol
+ * - countSyscalls: true if the pipe syscalls per turn are reported
+ * - offerShared: true if players are offered shared memory
+ * - spins: how long to busy-poll shared memory before sleeping
+ * - region: the shared memory for every player, or NULL if none use it
+ * - regionFd: the memfd holding region
+ * - pipePlayers: the number of players not on shared memory
+ */
+typedef struct EventLoop {
+    struct Hub* hubs;
+    int numHubs;
+    long numGames;
+    long firstDeck;
+    long gamesStarted;
+    int running;
+    int epoll;
+    bool offerBinary;
+    bool countSyscalls;
+    bool offerShared;
+    int spins;
+    SharedRegion* region;
+    int regionFd;
+    int pipePlayers;
+} EventLoop;
 
 /* struct of child processes' PIDs
  * - pid: a list of process IDs
@@ -86,10 +185,80 @@ typedef struct ChildProcesses {
     int numChildren; 
 } ChildProcesses;
 
+/* Counts of the syscalls made talking to players
+ * - turns: the number of moves processed
+ * - writes: writev calls sending messages (or futex wakes)
+ * - reads: read calls taking in replies
+ * - waits: epoll_wait calls (or futex waits)
+ */
+typedef struct Syscalls {
+    long turns;
+    long writes;
+    long reads;
+    long waits;
+} Syscalls;
+
+/* Records queued for the writer thread, from the hub's thread only. head
+ * and tail count every record ever queued and taken.
+ * - head: written by the hub's thread only
+ * - tail: written by the writer thread only
+ * - bell: rung to hurry the writer along
+ * - closed: set once nothing more will be queued
+ * - records: the records, record n at records[n % QUEUE_SIZE]
+ */
+typedef struct EventQueue {
+    uint32_t head __attribute__((aligned(CACHE_LINE)));
+    uint32_t tail __attribute__((aligned(CACHE_LINE)));
+    Bell bell;
+    uint32_t closed;
+    LogRecord records[QUEUE_SIZE];
+} EventQueue;
+
+/* Where the events of every table go
+ * - log: the event log, or NULL for none
+ * - mode: how the commentary is told (COMMENTARY_SYNC onwards)
+ * - commentary: tells the commentary, in the hub's thread or the writer's
+ * - queue: records waiting for the writer thread
+ * - writer: the writer thread
+ */
+typedef struct Events {
+    FILE* log;
+    int mode;
+    Commentary commentary;
+    EventQueue* queue;
+    pthread_t writer;
+} Events;
+
+/* Where the hub's time goes, if it is timing itself
+ * - path: the stats file the times are written to, or NULL if not timing
+ * - temp: where the stats file is written before it replaces path
+ * - written: when the stats file was last written
+ * - startup: starting a table's players until every one has answered
+ * - turn: for each seat, from yourturn being sent to the reply being
+ *   taken (the player's thinking, and getting messages there and back)
+ * - move: applying a reply and queuing what it caused for everyone
+ * - flush: sending everything queued for a table before a yourturn
+ */
+typedef struct Timing {
+    const char* path;
+    char* temp;
+    uint64_t written;
+    Histogram startup;
+    Histogram turn[MAX_PLAYERS];
+    Histogram move;
+    Histogram flush;
+} Timing;
+
 /* Global variables */
 
 // a struct to contain the PIDs of all children
 struct ChildProcesses* children = NULL;
+// the syscalls made so far
+struct Syscalls syscalls;
+// where events go
+struct Events events;
+// where the time goes
+struct Timing timing;
 
 /*
  * Exits the process with the given exitStatus.
@@ -100,8 +269,12 @@ void exit_with(int exitStatus) {
             exit(0);
             break;
         case 1:
-            fprintf(stderr, "Usage: hub deckfile prog1 prog2 [prog3"
-                    " [prog4]]\n");
+            fprintf(stderr, "Usage: hub [-b] [-s] [-m [-p spins]] "
+                    "[-g games] [-c tables] [-d deck] [-l logfile] "
+                    "[-t statsfile] [-a | -q] ([--stream [--wrap]] "
+                    "deckfile | "
+                    "--seed seed [--decks decks]) "
+                    "prog1 prog2 [prog3 [prog4]]\n");
             exit(1);
             break;
         case 2:
@@ -128,134 +301,53 @@ void exit_with(int exitStatus) {
             fprintf(stderr, "SIGINT caught\n");
             exit(7);
             break;
+        case 8:
+            fprintf(stderr, "Unable to create logfile\n");
+            exit(8);
+            break;
+        case 9:
+            fprintf(stderr, "Unable to create statsfile\n");
+            exit(9);
+            break;
         default:
             break;
     }
 }
 
-/*
- * Checks the sum and type of chars in the input array - corresponding to
- * a line in a deck file. The sum of all chars in the array must be 54.
- * There must be 5 x '1', 2 x '2', 2 x '3', 2 x '4', 2 x '5', 1 x '6',
- * 1 x '7' and 1 x '8'. 
- * Triggers exit if input does not contain those chars (as listed above).
- */
-void check_sum(char input[16]) {
-    /*Variables to be used*/
-    int getVal; //the value retrieved
-    int sum = 0; //the sum of the deck
-    int max[] = {5, 2, 2, 2, 2, 1, 1, 1}; //the maximum number of cards
-    int val[16]; //an array to store the values
-    int number[8] = {0, 0, 0, 0, 0, 0, 0, 0}; //the number of cards counted
-
-    // add the input to the val array
-    for (int i = 0; i < 16; i++) {
-        getVal = input[i] - '0'; //shift from char to int
-        val[i] = input[i] - '0';
-        sum += getVal; //increment the sum
-    }
-    //check right number of cards
-    if (sum != 54) {
-        exit_with(DECK_ERROR);
-    }
-    for (int i = 0; i < 16; i++) {
-        number[val[i] - 1] += 1;
-    }
-    //check if there are more of a certain card than allowed
-    for (int i = 0; i < 8; i++) {
-        if (number[i] != max[i]) {
-            exit_with(DECK_ERROR);
-        }
-    }
-}
-
-/*
- * Creates a linked list from the given file deckFile. Exits process
- * upon error in opening deckFile, reading a line, or incorrect line of
- * file. 
- */
-Deck *get_list_decks(FILE* deckFile) {
-    //check if deckFile is NULL
-    if (deckFile == NULL) {
-        exit_with(ACCESS_ERROR);
-    }
-    char *in, input[18]; //get first line of deckfile and check length
-    in = fgets(input, 18, deckFile);
-    if (input[16] != '\n') {
-        exit_with(DECK_ERROR);
-    }
-   
-    //create the head of the deck linked list
-    check_sum(input); //check the line has the right chars
-    Deck *head = malloc(sizeof(Deck));
-    head->pos = 1; //initialise to second card (i.e. discard 1st)
-    for (int i = 0; i < 16; i++) {
-        head->cards[i] = input[i]; //set head cards according to input
-    }
-    
-    /* Make a linked list */
-    head->nextDeck = NULL; //nextDeck is initially NULL
-    in = fgets(input, 18, deckFile); //get 18 in incase incorrect line 
-    while (in != NULL) { //loop through until we hit the last line
-        check_sum(input); //check the sum of the line
-        Deck* current = head;
-        while (current->nextDeck != NULL) { //go until null entry
-            current = current->nextDeck; //set current to nextDeck
-        }
-        Deck* newDeck = malloc(sizeof(Deck)); //malloc a newDeck
-        newDeck->pos = 1;
-        for (int j = 0; j < 16; j++) { //set up the newDeck
-            newDeck->cards[j] = input[j];
-        }
-        newDeck->nextDeck = NULL; //the newDeck is the current deck's
-        current->nextDeck = newDeck; //next deck
-        in = fgets(input, 18, deckFile); //get more input
-    }
-    Deck* current = head; //current is the ead
-    if (head->nextDeck == NULL) {
-        //if only one Deck file, reuse it   
-        head->nextDeck = head;
-    } else {
-        while(current->nextDeck != NULL) { //wrap the list around to make
-            current = current->nextDeck; //it a repeating linked list
-        }
-        //next Deck is null, wrap around to head
-        current->nextDeck = head;
-    }
-    return head;
-}
-
-/*
- * Handler for SIGINT. Sends SIGKILL to child processes in 
- * children global struct and performs a waitpid. Exits the program
- * with a SIGINT_ERROR
- */
-void kill_children(int s) {
-    int childStatus;
-    for (int i = 0; i < children->numChildren; i++) {
-        //kill child process and then wait on it
-        kill(children->pid[i], SIGKILL);
-        waitpid(children->pid[i], &childStatus, 0);
-    }
-    exit_with(SIGINT_ERROR);
-}
-
 /*
  * Performs a safe exit, shuts down child processes given in global
  * variable children by sending SIGKILL to them and waiting on them.
  * (NOTE: safe_exit as hub process reaps child processes instead
  * of leaving them to be reaped by init)
  */ 
-void safe_exit(struct Game* game) {
+void safe_exit(void) {
     int childStatus;
-    for (int i = 0; i < game->numPlayers; i++) {
-        //send SIGKILL to child process
+    for (int i = 0; i < children->numChildren; i++) {
+        //send SIGKILL to child process (plugins have no pid)
+        if (children->pid[i] <= 0) {
+            continue;
+        }
         kill(children->pid[i], SIGKILL);
         //wait for child process
         waitpid(children->pid[i], &childStatus, 0);
     }
 }
 
+/*
+ * Handler for SIGINT. Sends SIGKILL to child processes in 
+ * children global struct and performs a waitpid. Exits the program
+ * with a SIGINT_ERROR, straight away: the exit handlers would join the
+ * writer thread and flush stdout, which the interrupted code may be
+ * in the middle of.
+ */
+void kill_children(int s) {
+    static const char message[] = "SIGINT caught\n";
+
+    safe_exit();
+    write(STDERR_FILENO, message, sizeof(message) - 1);
+    _exit(SIGINT_ERROR);
+}
+
 /*
  * Initialise handlers for SIGINT and SIGPIPE
  */
@@ -274,70 +366,134 @@ void initialise_handler(void) {
     sigaction(SIGPIPE, &saPipeIgnore, 0);
 }
 
+
 /*
- * Checks if fork was successful by reading first character from each
- * child process pipe in the struct game. If the character is a '-', then
- * the fork was successful, if not, the process exits.
+ * Returns the time now if the hub is timing itself, and 0 otherwise.
  */
-void check_successful_fork(struct Game* game) {
+uint64_t start_timing(void) {
+    return timing.path != NULL ? now_nanos() : 0;
+}
+
+/*
+ * Adds the time since start (from start_timing) to histogram, if the hub
+ * is timing itself.
+ */
+void stop_timing(Histogram* histogram, uint64_t start) {
+    if (timing.path != NULL) {
+        record_latency(histogram, now_nanos() - start);
+    }
+}
+
+/*
+ * Checks if fork was successful by reading the first character from each
+ * child process pipe in the struct hub. If the character is a '-', then
+ * the fork was successful, if not, the process exits. A player that was
+ * offered the binary protocol may send '+' instead to take it up. A
+ * player that attached to its shared memory channel before answering is
+ * talked to through it from then on.
+ */
+void check_successful_fork(EventLoop* loop, struct Hub* hub) {
     char initialRead; //the char to read from the player
-    for (int i = 0; i < game->numPlayers; i++) {
-        //read from each pipe
-        //fprintf(stderr, "here\n");
-        initialRead = fgetc(game->pipes[i].read);
-        //fprintf(stderr, "here2\n");
-        if (initialRead != '-') {
-            safe_exit(game);
+    for (int i = 0; i < hub->game.numPlayers; i++) {
+        if (hub->pipes[i].strategy != NULL) {
+            continue;
+        }
+        //read from each pipe (still blocking at this point)
+        if (read(hub->pipes[i].read.fd, &initialRead, 1) != 1 ||
+                !(initialRead == WIRE_TEXT || (initialRead == WIRE_BINARY
+                && hub->offerBinary))) {
+            safe_exit();
             exit_with(FORK_ERROR);
         }
+        hub->pipes[i].binary = initialRead == WIRE_BINARY;
+        fcntl(hub->pipes[i].read.fd, F_SETFL, O_NONBLOCK);
+        Channel* channel = loop->region == NULL ? NULL :
+                &loop->region->channels[hub->firstChannel + i];
+        if (channel != NULL &&
+                __atomic_load_n(&channel->attached, __ATOMIC_ACQUIRE)) {
+            hub->pipes[i].channel = channel;
+            hub->pipes[i].read.ring = &channel->toHub;
+        } else {
+            loop->pipePlayers++;
+        }
     }   
 }
 
 /* 
  * Attempts to create the processes given by childProgram. Will
- * exit program upon fork or pipe error. Sets up pipes in game to 
- * for bidirectional communication with child processes.
+ * exit program upon fork or pipe error. Sets up pipes in hub to 
+ * for bidirectional communication with child processes. The hub's ends
+ * of the pipes are closed on exec, so no player holds another's pipes.
+ * Players are offered the shared memory of loop (if there is any). A
+ * program of the form lib:path is a strategy plugin, which is loaded
+ * and played in the hub's own process instead.
  */
-void create_children(struct Game* game, char** childProgram) {
+void create_children(EventLoop* loop, struct Hub* hub,
+        char** childProgram) {
     /* Set up the bitBucket for stderr redirection */
-    FILE* bitBucket = fopen("/dev/null", "w");
-    int bitBucketNumber = fileno(bitBucket);
-    char* count = malloc(sizeof(char) * 2); //create string for the count
-    count[0] = game->numPlayers + 48; //make it ascii
+    int bitBucketNumber = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    char count[2]; //create string for the count
+    count[0] = hub->game.numPlayers + 48; //make it ascii
     count[1] = '\0'; //add null terminator
     
     //Loop through once for each player and fork and exec the appropriate
     //process from childProgram
-    for (int i = 0; i < game->numPlayers; i++) {
+    for (int i = 0; i < hub->game.numPlayers; i++) {
         int read[2]; //an array of file descriptorts for reading
         int write[2]; //an array of file descriptors for writing
         int pid; //the pid
+
+        //a plugin needs no process, or pipes
+        if (strncmp(childProgram[i], STRATEGY_PREFIX,
+                strlen(STRATEGY_PREFIX)) == 0) {
+            hub->pids[i] = -1;
+            children->numChildren++;
+            hub->pipes[i].strategy = find_strategy(childProgram[i]);
+            if (hub->pipes[i].strategy == NULL) {
+                safe_exit();
+                exit_with(FORK_ERROR);
+            }
+            hub->pipes[i].state = hub->pipes[i].strategy->create(
+                    hub->game.numPlayers, i + SHIFT);
+            continue;
+        }
     
         // pipe, and check for failure
-        if(pipe(read) == -1 || pipe(write) == -1) {
+        if(pipe2(read, O_CLOEXEC) == -1 || pipe2(write, O_CLOEXEC) == -1) {
+            safe_exit();
             exit_with(FORK_ERROR);
         }
         pid = fork();
         if(pid) { //we are the parent (the hub)
-            children->pid[i] = pid;
-            game->pipes[i].write = fdopen(read[WRITE], "w");
+            hub->pids[i] = pid;
+            children->numChildren++;
+            hub->pipes[i].write = read[WRITE];
             close(read[READ]); //close read end
-            game->pipes[i].read = fdopen(write[READ], "r");
+            init_framer(&hub->pipes[i].read, write[READ]);
             close(write[WRITE]); //close write end    
-            game->players[i].label = i + SHIFT; //shift for ascii
-            game->players[i].outOfRound = false; //set not out
-            game->players[i].protected = false; //set not protected
         } else {
             //we are the child
-            close(read[WRITE]); //close write end
             dup2(read[READ], STDIN_FILENO); //redirect stdin to pipe
-            close(read[READ]); //close read end
-            close(write[READ]); //close read end
             dup2(write[WRITE], STDOUT_FILENO); //redirect stdout to pipe
-            close(write[WRITE]); //close write end
             //hook up stderr to bitbucket
             dup2(bitBucketNumber, STDERR_FILENO); 
-            char* designator = malloc(sizeof(char) * 2);
+            //offer the binary protocol, or make sure it is not offered
+            if (hub->offerBinary) {
+                setenv(WIRE_ENV, "binary", 1);
+            } else {
+                unsetenv(WIRE_ENV);
+            }
+            //hand over the shared memory, or make sure it is not offered
+            if (loop->region != NULL) {
+                char shared[64];
+                sprintf(shared, "%d %d %d", loop->regionFd,
+                        hub->firstChannel + i, loop->spins);
+                fcntl(loop->regionFd, F_SETFD, 0);
+                setenv(SHM_ENV, shared, 1);
+            } else {
+                unsetenv(SHM_ENV);
+            }
+            char designator[2];
             designator[0] = i + SHIFT;
             designator[1] = '\0';   
             execlp(childProgram[i], "player", count, designator, NULL);
@@ -346,767 +502,929 @@ void create_children(struct Game* game, char** childProgram) {
             exit(1); //exit
         }   
     }
+    close(bitBucketNumber);
     //check for successful fork
-    check_successful_fork(game);
+    check_successful_fork(loop, hub);
 }
 
 /*
- * Returns a boolean to indicate if there is a winner.
- * A winner is indicated by a player with a score == 4.
+ * Sends everything queued for stream with a single writev (or a single
+ * ring write, which only needs a syscall if the player is asleep).
  */
-bool is_winner(struct Game* game) {
-    /* Initialise the return value */
-    bool returnValue = false;
-   
-    //Loop through all players and check their score, check for 
-    //>= 4 in case of error 
-    for (int i = 0; i < game->numPlayers; i++) {
-        if(game->scores[i] >= 4) {
-            returnValue = true;
+void flush_stream(Stream* stream) {
+    if (stream->numParts > 0) {
+        if (stream->channel != NULL) {
+            if (ring_write(&stream->channel->toPlayer,
+                    &stream->channel->bell, stream->parts,
+                    stream->numParts)) {
+                syscalls.writes++;
+            }
+        } else {
+            writev(stream->write, stream->parts, stream->numParts);
+            syscalls.writes++;
         }
+        stream->numParts = 0;
+        stream->ownLength = 0;
     }
-    return returnValue;
 }
 
 /*
- * Checks if end of round conditions are met. Conditions: all players bar 
- * one are eliminated or there are no cards left in the deck.
+ * Sends everything queued for each player at hub's table.
  */
-bool check_end_of_round(struct Game* game) {
-    //An int to record the number of players that are out
-    int numOut = 0;
-    
-    //Loop through and check the number that are out
-    for (int i = 0; i < game->numPlayers; i++) {
-        if (game->players[i].outOfRound) {
-            numOut++;
-        }
+void flush_output(struct Hub* hub) {
+    for (int i = 0; i < hub->game.numPlayers; i++) {
+        flush_stream(&hub->pipes[i]);
     }
-    //if it's 16 then we finished the Deck, and the round is over
-    if(game->deck->pos == 16) {
-        return true;
-    } else if (numOut == (game->numPlayers - 1)) {
-        //If all bar one players are out, then the round is over
-        return true;
+    hub->sharedLength = 0;
+}
+
+/*
+ * Queues length bytes of data to be sent to player at the next flush.
+ * Unless the data is shared (kept in hub until the flush, see
+ * share_output), it is copied for the player.
+ */
+void queue_output(struct Hub* hub, int player, const char* data,
+        int length, bool shared) {
+    Stream* stream = &hub->pipes[player];
+    char* start = (char*)data;
+
+    if (stream->numParts == MAX_PARTS ||
+            stream->ownLength + length > OUT_BUFFER) {
+        flush_stream(stream);
+    }
+    if (!shared) {
+        start = stream->own + stream->ownLength;
+        memcpy(start, data, length);
+        stream->ownLength += length;
+    }
+    //a part that carries straight on from the last one joins it
+    struct iovec* last = stream->parts + stream->numParts;
+    if (stream->numParts > 0 &&
+            (char*)last[-1].iov_base + last[-1].iov_len == start) {
+        last[-1].iov_len += length;
     } else {
-        return false;
+        stream->parts[stream->numParts].iov_base = start;
+        stream->parts[stream->numParts].iov_len = length;
+        stream->numParts++;
     }
 }
 
 /*
- * Sends scores to child processes and Round winner(s) message to stdout
- */ 
-void send_scores(struct Game* game) {
-    //Initialise the score string to contain 'scores' and the number 
-    //of scores for the number of players playing
-    char scoresString[8 + (2 * game->numPlayers)];
-    
-    //Build the string according to the number of players
-    switch(game->numPlayers) {
-        case 2: 
-            sprintf(scoresString, "scores %d %d\n", game->scores[0],
-                    game->scores[1]); 
-            break;
-        case 3: 
-            sprintf(scoresString, "scores %d %d %d\n", game->scores[0],
-                    game->scores[1], game->scores[2]); 
-            break;
-        case 4: 
-            sprintf(scoresString, "scores %d %d %d %d\n", game->scores[0], 
-                    game->scores[1], game->scores[2], game->scores[3]); 
-            break;
-        default: 
-            sprintf(scoresString, "error\n"); 
-            break;
-    }
-    //Send out the string
-    for (int i = 0; i < game->numPlayers; i++) {
-        fprintf(game->pipes[i].write, "%s", scoresString);
+ * Queues a message that is the same for every player of a protocol: the
+ * text form goes to text players, and the binary record to the others.
+ * Both are kept once in hub until the flush, and every player's write
+ * points at the same copy.
+ */
+void queue_everyone(struct Hub* hub, const char* text, int textLength,
+        const unsigned char* record, int recordLength) {
+    if (hub->sharedLength + textLength + recordLength > SHARED_BUFFER) {
+        flush_output(hub);
     }
-    char high = '0';
-    //Send out the round winner(s) message
-    for (int j = 0; j < game->numPlayers; j++) {
-        if (!(game->players[j].outOfRound) && 
-                game->players[j].holding >= high) {
-            high = game->players[j].holding;
+    char* sharedText = hub->shared + hub->sharedLength;
+    memcpy(sharedText, text, textLength);
+    char* sharedRecord = sharedText + textLength;
+    memcpy(sharedRecord, record, recordLength);
+    hub->sharedLength += textLength + recordLength;
+
+    for (int i = 0; i < hub->game.numPlayers; i++) {
+        if (hub->pipes[i].strategy != NULL) {
+            continue;
+        } else if (hub->pipes[i].binary) {
+            queue_output(hub, i, sharedRecord, recordLength, true);
+        } else {
+            queue_output(hub, i, sharedText, textLength, true);
         }
     }
-    //Send round winners to stdout, adding " %c" (c is winner) accordingly
-    fprintf(stdout, "Round winner(s) holding %c:", high);
-    for (int k = 0; k < game->numPlayers; k++) {
-        if(!(game->players[k].outOfRound) && game->players[k].holding
-                == high) {
-            fprintf(stdout, " %c", k + SHIFT);
-        }
+}
+
+/*
+ * Hands record to the writer thread, waiting for room if it has fallen
+ * a whole queue behind.
+ */
+void queue_record(EventQueue* queue, const LogRecord* record) {
+    uint32_t head = queue->head;
+
+    while (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) ==
+            QUEUE_SIZE) {
+        bell_ring(&queue->bell);
+        sched_yield();
+    }
+    queue->records[head % QUEUE_SIZE] = *record;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    //the writer wakes up by itself soon, unless it is falling behind
+    if (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) ==
+            QUEUE_SIZE / 2) {
+        bell_ring(&queue->bell);
     }
-    fprintf(stdout, "\n"); //top off with newline
-    fflush(stdout);
 }
 
 /*
- * Returns the next card in the current deck, or '-' if the last card in
- * the deck has been reached.
+ * Records something of type that happened at hub, for seat and with
+ * length bytes of data, at the game and round hub is up to. It goes to
+ * the event log (if any) and the commentary.
  */
-char get_next_card(struct Game* game) {
-    //The current pos we are up to
-    int pos = game->deck->pos;
-    
-    if (pos < 16) {
-        pos = game->deck->pos++;
-        return game->deck->cards[pos];
-    } else {
-        return '-';
+void log_event(struct Hub* hub, int type, int seat, const char* data,
+        int length) {
+    LogRecord record;
+
+    if (events.log == NULL && events.mode == COMMENTARY_QUIET) {
+        return;
+    }
+    memset(&record, 0, sizeof(LogRecord));
+    record.type = type;
+    record.seat = seat;
+    record.table = hub->table;
+    record.game = hub->gamesPlayed;
+    record.round = hub->game.round;
+    memcpy(record.data, data, length);
+    if (events.log != NULL) {
+        write_log(events.log, &record);
     }
-} 
+    if (events.mode == COMMENTARY_SYNC) {
+        comment_record(&events.commentary, &record);
+        fflush(stdout);
+    } else if (events.mode == COMMENTARY_ASYNC) {
+        queue_record(events.queue, &record);
+    }
+}
 
 /*
- * Checks if there are unprotected players who are still playing the game
- * and who are not the player.
- * Returns true if there are, false otherwise.
+ * Sends scores to child processes and Round winner(s) message to the
+ * commentary
  */ 
-bool target_available(struct Game* game, int player) {
-    bool val = false; //the return value
-
-    //check if they are unprotected and not out of the round and not
-    //the player that initialised the search
+void send_scores(struct Hub* hub) {
+    struct Game* game = &hub->game;
+    //Initialise the score string to contain 'scores' and the number 
+    //of scores for the number of players playing
+    char scoresString[8 + (2 * MAX_PLAYERS)];
+    int length = sprintf(scoresString, "scores");
+    
+    //Build the string according to the number of players
+    for (int i = 0; i < game->numPlayers; i++) {
+        length += sprintf(scoresString + length, " %d", game->scores[i]);
+    }
+    length += sprintf(scoresString + length, "\n");
+    unsigned char record[3];
+    encode_scores(record, game->scores, game->numPlayers);
+    //Send out the string
+    queue_everyone(hub, scoresString, length, record, sizeof(record));
     for (int i = 0; i < game->numPlayers; i++) {
-        if (game->players[i].protected == false && 
-                game->players[i].outOfRound == false && i != player) {
-            val = true;
+        Stream* stream = &hub->pipes[i];
+        if (stream->strategy != NULL) {
+            stream->strategy->on_scores(stream->state, game->scores,
+                    game->numPlayers);
         }
     }
-    return val;
+    //Send out the round winner(s) message
+    int winners;
+    char high = find_round_winners(game, &winners);
+    char data[LOG_SCORES_SCORES + MAX_PLAYERS] = {high, winners};
+    for (int i = 0; i < game->numPlayers; i++) {
+        data[LOG_SCORES_SCORES + i] = game->scores[i];
+    }
+    log_event(hub, LOG_SCORES, 0, data, sizeof(data));
 }
 
 /*
  * Sends a thishappened to each player process of the form:
  * - thishappened: player|card|targetPlayer|guessCard|/|dropper|dropped|
  *   elimated|\n
- * where:
- * - player: player who made move
- * - card: played card
- * - targetPlayer: the targetPlayer
- * - guessCard: the card being guessed
- * - dropper: the player dropping their card
- * - dropped: the dropped card
- * - eliminated: the eliminated player
+ * where the fields are those of event.
  */ 
-void send_this_happened(struct Game* game, char player, char card, 
-        char targetPlayer, char guessCard, char dropper, char dropped,
-        char eliminated) {
+void send_this_happened(struct Hub* hub, const Event* event) {
+    unsigned char record[4];
+    char text[24];
+    encode_event(record, event->player, event->card, event->target,
+            event->guess, event->dropper, event->dropped,
+            event->eliminated);
+    int length = sprintf(text, "thishappened %c%c%c%c/%c%c%c\n",
+            event->player, event->card, event->target, event->guess,
+            event->dropper, event->dropped, event->eliminated);
     //Send thishappened according to the given inputs
-    for (int i = 0; i < game->numPlayers; i++) {
-        fprintf(game->pipes[i].write, "thishappened %c%c%c%c/%c%c%c\n",
-                player, card, targetPlayer, guessCard, dropper, dropped,
-                eliminated);
-        fflush(game->pipes[i].write);
-    }  
+    queue_everyone(hub, text, length, record, sizeof(record));
+    for (int i = 0; i < hub->game.numPlayers; i++) {
+        Stream* stream = &hub->pipes[i];
+        if (stream->strategy != NULL) {
+            stream->strategy->on_thishappened(stream->state, event);
+        }
+    }
 }
 
 /*
- * Perform a swap between a player and a targetPlayer. Triggered by a 6.
- * Where:
- * - player: player making move
- * - targetPlayer: the targeted player
- * - holding: the card the player is holding
- * - guess: the card they are guessing
- * If the player is holding a 7 then the process exits with MESSAGE_ERROR
+ * Hands a message made of a type and maybe a card to the strategy plugin
+ * playing player. Its answer to yourturn is kept until it is wanted.
  */ 
-void swap(struct Game* game, int player, char targetPlayer, char holding, 
-        char guess) {
-    // can't discard 5/6 in preference to 7
-    if (holding == '7' || (targetPlayer == '-' && 
-            target_available(game, player)) || guess != '-') {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
+void call_strategy(struct Hub* hub, int player, int type, char card) {
+    Stream* stream = &hub->pipes[player];
+    const Strategy* strategy = stream->strategy;
+
+    switch (type) {
+        case WIRE_NEWROUND:
+            strategy->on_newround(stream->state, card);
+            break;
+        case WIRE_YOURTURN:
+            strategy->on_yourturn(stream->state, card, stream->move);
+            break;
+        case WIRE_REPLACE:
+            strategy->on_replace(stream->state, card);
+            break;
+        case WIRE_NEWGAME:
+        case WIRE_GAMEOVER:
+            //forget everything, and start over for a new game
+            if (strategy->destroy != NULL) {
+                strategy->destroy(stream->state);
+            }
+            stream->state = type == WIRE_NEWGAME ?
+                    strategy->create(hub->game.numPlayers, player + SHIFT) :
+                    NULL;
+            break;
     }
-    
-    //Check targetPlayer is a player
-    if (targetPlayer != '-') {
-        //send whatever the player was holding to target
-        fprintf(game->pipes[targetPlayer - SHIFT].write, "replace %c\n", 
-                holding);
-        fflush(game->pipes[targetPlayer - SHIFT].write);
-        
-       //send what the target was holding to player
-        fprintf(game->pipes[player].write, "replace %c\n", 
-                game->players[targetPlayer - SHIFT].holding);
-        fflush(game->pipes[player].write);
-        
-        //update state
-        char c = game->players[targetPlayer - SHIFT].holding;
-        game->players[targetPlayer - SHIFT].holding = 
-                game->players[player].holding;
-        game->players[player].holding = c;
-        
-        //print message to stdout
-        fprintf(stdout, "Player %c discarded 6 aimed at %c.\n", 
-                player + SHIFT, targetPlayer);
-        fflush(stdout);
-        
-        //send thishappened
-        send_this_happened(game, player + SHIFT, '6', targetPlayer, '-',
-                '-', '-', '-');
+}
+
+/*
+ * Sends a message made of a type and maybe a card (newround, yourturn,
+ * replace, newgame or gameover) to player, for example: yourturn 3
+ */ 
+void send_message(struct Hub* hub, int player, int type, char card) {
+    char message[16];
+    int length;
+
+    if (hub->pipes[player].strategy != NULL) {
+        call_strategy(hub, player, type, card);
+        return;
+    } else if (hub->pipes[player].binary) {
+        message[0] = type;
+        message[1] = card != '\0' ? encode_card(card) : 0;
+        length = 2;
+    } else if (card != '\0') {
+        length = sprintf(message, "%s %c\n", wire_name(type), card);
     } else {
-        //There was no target, just say discarded.
-        fprintf(stdout, "Player %c discarded 6.\n", player + SHIFT);
-        fflush(stdout);
-        send_this_happened(game, player + SHIFT, '6', targetPlayer, '-',
-                '-', '-', '-');
+        length = sprintf(message, "%s\n", wire_name(type));
     }
+    queue_output(hub, player, message, length, false);
 }
 
 /*
- * Triggered by card 5, target gets new card from deck. 
- * Where:
- * - player: the player making the move
- * - targetPlayer: the player being targeted
- * - holding: the card player is holding
- * - guess: the guess being made
- * If the player is holding a 7 then the process exits with MESSAGE_ERROR
+ * Sends the replace messages caused by a move, in order.
  */ 
-void new_card(struct Game* game, int player, char targetPlayer, 
-        char holding, char guess) {
-    //Get the next deckCard (note: it incremements the pos count)
-    char deckCard = get_next_card(game);
-    
-    // if '-', wrap around the the first card
-    if (deckCard == '-') {
-        deckCard = game->deck->cards[0];
+void send_replaces(struct Hub* hub, const Outcome* outcome) {
+    for (int i = 0; i < outcome->numReplaced; i++) {
+        send_message(hub, outcome->replacedSeat[i], WIRE_REPLACE,
+                outcome->replacedCard[i]);
     }
-    //can't keep 7 and throw out 6/5, not allowed a guess, must target self
-    if (holding == '7' || targetPlayer == '-' || guess != '-') {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
-    }
- 
-    //Send replace message to target
-    fprintf(game->pipes[targetPlayer - SHIFT].write, "replace %c\n",
-            deckCard);
-    fflush(game->pipes[targetPlayer - SHIFT].write);
-    
-    //get card they are holding before it chagnes
-    char oldCard = game->players[targetPlayer - SHIFT].holding;
-    game->players[targetPlayer - SHIFT].holding = deckCard;
-    
-    //send discard information
-    fprintf(stdout, "Player %c discarded 5 aimed at %c. This forced %c" 
-            " to discard %c.", player + SHIFT, targetPlayer, targetPlayer, 
-            oldCard);
-    fflush(stdout);
+}
 
-    //check oldCard was 8 (they are outOfRound)
-    if (oldCard == '8') {
-        //They discarded an 8, so are out and do not get a card
-        fprintf(stdout, " %c was out.\n", targetPlayer);
-        game->players[targetPlayer - SHIFT].outOfRound = true;
-        game->deck->pos--; //we just incremented the position
-    } else {
-        fprintf(stdout, "\n");
-    }
-    fflush(stdout);
+/*
+ * Records the move sent by the player the hub was waiting on, which
+ * caused event, for the commentary and the log. The move has already
+ * been applied to the hub's game.
+ */ 
+void report_move(struct Hub* hub, const char* move, const Event* event) {
+    char dropped = shown_dropped(&hub->game, event);
+    char data[LOG_MOVE_SHOWN + 1] = {move[0], move[1], move[2],
+            event->player, event->card, event->target, event->guess,
+            event->dropper, event->dropped, event->eliminated, dropped};
+    log_event(hub, LOG_MOVE, hub->waiting, data, sizeof(data));
+}
 
-    //send thishappened information
-    if (oldCard != '8') {
-        send_this_happened(game, player + SHIFT, '5', targetPlayer, '-',
-                targetPlayer, oldCard, '-');
-    } else {
-        send_this_happened(game, player + SHIFT, '5', targetPlayer, '-',
-                targetPlayer, oldCard, targetPlayer);
-    }   
+/*
+ * Send winner information to the commentary (which writes out a whole
+ * buffered game now, so games never interleave).
+ */ 
+void send_winner(struct Hub* hub) {
+    char data[MAX_PLAYERS];
+
+    for (int i = 0; i < hub->game.numPlayers; i++) {
+        data[i] = hub->game.scores[i];
+    }
+    log_event(hub, LOG_WINNER, 0, data, hub->game.numPlayers);
 }
 
 /*
- * Runs a compare card move for a valid targetPlayer, triggered by a 3.
- * Where:
- * - player: the player making the move
- * - targetPlayer: the player being targeted
- * - guess: the card being guessed
- * - compareTo: the card held by targetPlayer
- * - compareFrom: the card held by player
- */
-void compare_valid_target(struct Game* game, int player, char targetPlayer,
-        char guess, char compareTo, char compareFrom) {
-    /*Varaibles: the loser and the discarded card */
-    char loser;
-    char discarded = '-';
-
-    //Compare the two cards held by player and targetPlayer
-    if (compareTo > compareFrom) {
-        //player's card is greater
-        game->players[player].outOfRound = true;
-        loser = player + SHIFT;
-        
-        //get and send discarded message 
-        char discarded = game->players[loser - SHIFT].holding;
-        fprintf(stdout, "Player %c discarded 3 aimed at %c. This forced"
-                " %c to discard %c. %c was out.\n", player + SHIFT, 
-                targetPlayer, loser, discarded, loser);
-        fflush(stdout);
-        game->players[loser - SHIFT].outOfRound = true;
-    } else if (compareFrom > compareTo) {
-        //player's card is lower
-        game->players[targetPlayer - SHIFT].outOfRound = true;
-        loser = targetPlayer;
-        
-        //get and send discarded message
-        char discarded = game->players[loser - SHIFT].holding;
-        fprintf(stdout, "Player %c discarded 3 aimed at %c. This forced"
-                " %c to discard %c. %c was out.\n", player + SHIFT, 
-                targetPlayer, loser, discarded, loser);
-        fflush(stdout);
-        game->players[loser - SHIFT].outOfRound = true;
-    } else {
-        //The card is the same, no swap occurs
-        loser = '-';
-        fprintf(stdout, "Player %c discarded 3 aimed at %c.\n",
-                player + SHIFT, targetPlayer);
-        fflush(stdout); 
-    }   
+ * Reads whatever player has sent so far, without blocking. A read that
+ * does not fill the space it was given has emptied the pipe, so there is
+ * no need for another read to see EAGAIN.
+ */ 
+void fill_reader(Framer* framer) {
+    ssize_t got;
+    int space;
 
-    //Send a thishappened message
-    send_this_happened(game, player + SHIFT, '3', targetPlayer, '-', loser,
-            discarded, loser);
-} 
+    do {
+        space = FRAME_BUFFER - framer->end;
+        if (framer->ring == NULL) {
+            syscalls.reads++;
+        }
+        got = read_frames(framer);
+    } while (got > 0 && got >= space);
+}
 
 /*
- * Compare between a player and a targetPlayer, triggered by a 3, checks 
- * the conditions of targetPlayer and guess, if there is a valid target, 
- *  calls compare_valid_target
- * Where:
- * - player: the player who made the move
- * - targetPlayer: the player being targted
- * - guess: the card being guessed
+ * Finds the reply of player, which must be of the form c1pc2, pointing
+ * message at it where it was read (or at its text form in hub, for a
+ * binary reply). Returns false if the whole reply has not arrived yet.
+ * Only reads from the player if fill is true, otherwise just looks at
+ * what has been read already. Exits with QUIT_ERROR if the player quit,
+ * and MESSAGE_ERROR if the reply is the wrong length.
  */ 
-void compare(struct Game* game, int player, char targetPlayer, char guess)
-{
-    //The cards to compareTo and compareFrom
-    char compareFrom = game->players[player].holding;       
-    char compareTo = game->players[targetPlayer - SHIFT].holding;
-    
-    //check if no target when there can be
-    //check if there is a guess
-    if (guess != '-' || (targetPlayer == '-' && 
-            target_available(game, player))) {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
-    } 
-    if (targetPlayer == '-') {
-        fprintf(stdout, "Player %c discarded 3.\n", player + SHIFT);
-        send_this_happened(game, player + SHIFT, '3', targetPlayer, '-', 
-                '-', '-', '-');
-        fflush(stdout);
+bool take_move(struct Hub* hub, int player, char** message, bool fill) {
+    Framer* framer = &hub->pipes[player].read;
+    int length;
+
+    //a plugin has always answered already
+    if (hub->pipes[player].strategy != NULL) {
+        *message = hub->pipes[player].move;
+        return true;
+    }
+    if (fill) {
+        fill_reader(framer);
+    }
+    if (hub->pipes[player].binary) {
+        char* record;
+        length = next_record(framer, WIRE_MOVE_SIZE, &record);
+        if (length == WIRE_MOVE_SIZE) {
+            decode_move((unsigned char*)record, hub->move);
+            *message = hub->move;
+            length = MOVE_LENGTH;
+        }
     } else {
-        compare_valid_target(game, player, targetPlayer, guess,
-                compareTo, compareFrom);
+        length = next_frame(framer, MOVE_LENGTH, message);
     }
+    if (length == FRAME_WAIT) {
+        return false;
+    } else if (length == FRAME_EOF) {
+        //the player has gone so they quit
+        safe_exit();
+        exit_with(QUIT_ERROR);
+    } else if (length != MOVE_LENGTH) {
+        safe_exit();
+        exit_with(MESSAGE_ERROR);
+    }
+    return true;
 }
 
 /*
- * Prints out status information and sends thishappened based on
- * a valid target (one which is not '-'). 
+ * Applies the move in message made by the player the hub was waiting
+ * on, and tells everyone what happened.
  */ 
-void valid_target_guess(struct Game* game, int player, char targetPlayer,
-        char guess) {
-    //bool to indicate if the targetPlayer is out
-    bool out = false;
-    
-    if (game->players[targetPlayer - SHIFT].holding == guess) {
-        game->players[targetPlayer - SHIFT].outOfRound = true;
-        out = true;
+void process_move(struct Hub* hub, const char* message) {
+    Outcome outcome;
+
+    if (apply_move(&hub->game, hub->waiting, message, &outcome) !=
+            MOVE_OK) {
+        safe_exit();
+        exit_with(MESSAGE_ERROR);
     }
-    
-    //If the target is out send appropriate message
-    if (out) {
-        fprintf(stdout, "Player %c discarded 1 aimed at %c guessing" 
-                " %c. This forced %c to discard %c. %c was out.\n", 
-                player + SHIFT, targetPlayer, guess, targetPlayer, 
-                guess, targetPlayer);
-        fflush(stdout);
-        send_this_happened(game, player + SHIFT, '1', targetPlayer, 
-                guess, targetPlayer, guess, targetPlayer);
-    } else {
+    report_move(hub, message, &outcome.event);
+    hub->waiting = -1;
+    syscalls.turns++;
+    send_replaces(hub, &outcome);
+    send_this_happened(hub, &outcome.event);
+}
 
-        //if guess is - then just say discarded card aimed at target
-        if (guess == '-') {
-            fprintf(stdout, "Player %c discarded 1 aimed at %c.\n",
-                    player + SHIFT, targetPlayer);
-            fflush(stdout);
-            send_this_happened(game, player + SHIFT, '1', 
-                    targetPlayer, '-', '-', '-', '-');
-        } else {
-        	//The target isn't out, send appropriate message
-            fprintf(stdout, "Player %c discarded 1 aimed at %c "
-                    "guessing %c.\n", player + SHIFT, targetPlayer, 
-                    guess);
-            fflush(stdout);
-            send_this_happened(game, player + SHIFT, '1', targetPlayer,
-                    guess, '-', '-', '-');
+/*
+ * Starts the next game on hub if there are games left to play, sending
+ * newgame if its players have played before. Returns false (and sends
+ * gameover and shuts down the table's children) if there are none.
+ */
+bool next_game(EventLoop* loop, struct Hub* hub) {
+    if (loop->gamesStarted == loop->numGames) {
+        //send gameover to each child, and then to be sure, kill them
+        int childStatus;
+        for (int i = 0; i < hub->game.numPlayers; i++) {
+            send_message(hub, i, WIRE_GAMEOVER, '\0');
+        }
+        flush_output(hub);
+        for (int i = 0; i < hub->game.numPlayers; i++) {
+            if (hub->pids[i] <= 0) {
+                continue;
+            }
+            kill(hub->pids[i], SIGKILL);
+            waitpid(hub->pids[i], &childStatus, 0); 
+        }
+        loop->running--;
+        return false;
+    }
+    loop->gamesStarted++;
+    if (hub->gamesPlayed > 0) {
+        //scores go back to 0, players keep running
+        init_game(&hub->game, hub->game.numPlayers, hub->game.corpus,
+                hub->game.deckIndex);
+        for (int i = 0; i < hub->game.numPlayers; i++) {
+            send_message(hub, i, WIRE_NEWGAME, '\0');
         }
-    
     }
+    char numPlayers = hub->game.numPlayers;
+    log_event(hub, LOG_GAME, 0, &numPlayers, 1);
+    return true;
 }
 
 /*
- * Performs a guess move, triggered by a 1.  Where:
- * - player: the player who made the move
- * - targetPlayer: the target
- * - guess: the guess card
- * Exits program with MESSAGE_ERROR if guess is a '1' or error conditions
- * are met (such as targeting someone when no target is required)
- */ 
-void guess_card(struct Game* game, int player, char targetPlayer, 
-        char guess) {
-    /*Set out boolean to tell if the targetPlayer is out*/
-    //bool out = false;
-    //guess cannot be 1, check target valid  
-    if (guess == '1' || (targetPlayer == '-' && target_available(game,
-            player) == true)) {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
+ * Writes the times taken so far, and the games finished by every table
+ * of loop, to the stats file: a games line, then a latency line (see
+ * latency.h) for each phase timed, and each seat's turns. The file is
+ * replaced whole, so it can be read while the hub writes it again.
+ * Returns false if it could not be written.
+ */
+bool write_stats(EventLoop* loop) {
+    long gamesPlayed = 0;
+
+    timing.written = now_nanos();
+    FILE* stats = fopen(timing.temp, "w");
+    if (stats == NULL) {
+        return false;
     }
+    for (int t = 0; t < loop->numHubs; t++) {
+        gamesPlayed += loop->hubs[t].gamesPlayed;
+    }
+    fprintf(stats, "games %ld\n", gamesPlayed);
+    fprintf(stats, "%s\n", LATENCY_COLUMNS);
+    write_latency(stats, "startup", '-', &timing.startup);
+    for (int i = 0; i < loop->hubs[0].game.numPlayers; i++) {
+        write_latency(stats, "turn", i + SHIFT, &timing.turn[i]);
+    }
+    write_latency(stats, "move", '-', &timing.move);
+    write_latency(stats, "flush", '-', &timing.flush);
+    return fclose(stats) == 0 && rename(timing.temp, timing.path) == 0;
+}
 
-    if (targetPlayer != '-') {  
-        //the target is valid, send to valid_target_guess
-        valid_target_guess(game, player, targetPlayer, guess); 
-    } else {
-        //  The targetPlayer was just '-' so just say discarded
-        //  guess must be -, as message of form 1--
-        if (guess != '-') {
-            safe_exit(game);
-            exit_with(MESSAGE_ERROR);
+/*
+ * Plays hub's games for as long as it can without waiting on a player:
+ * starts rounds and games, sends yourturn and processes any reply that
+ * has already arrived. Returns once a reply is outstanding or the table
+ * has no more games to play. Messages are queued as they come up and
+ * sent in one flush before waiting.
+ */
+void advance(EventLoop* loop, struct Hub* hub) {
+    struct Game* game = &hub->game;
+    char* message;
+    int player;
+    bool arrived = true; //a reply may have come in since the last look
+
+    while (hub->waiting < 0 ||
+            take_move(hub, hub->waiting, &message, arrived)) {
+        if (hub->waiting >= 0) {
+            stop_timing(&timing.turn[hub->waiting], hub->askedAt);
+            uint64_t moved = start_timing();
+            process_move(hub, message);
+            stop_timing(&timing.move, moved);
         }
-        fprintf(stdout, "Player %c discarded 1.\n", player + SHIFT);
-        fflush(stdout);
-        send_this_happened(game, player + SHIFT, '1', '-', '-', '-', 
-                '-', '-');
-    } 
+        if (!hub->inRound) {
+            //a game ends with a winner, start the next one (if any)
+            if (is_winner(game)) {
+                send_winner(hub);
+                hub->gamesPlayed++;
+                if (timing.path != NULL &&
+                        now_nanos() - timing.written >= STATS_PERIOD) {
+                    write_stats(loop);
+                }
+                if (!next_game(loop, hub)) {
+                    return;
+                }
+            }
+            //start of a new round, give each player their card
+            if (!start_round(game)) {
+                safe_exit();
+                exit_with(DECK_ERROR);
+            }
+            log_event(hub, LOG_ROUND, 0, game->deck.cards, DECK_SIZE);
+            for(int i = 0; i < game->numPlayers; i++) {
+                send_message(hub, i, WIRE_NEWROUND,
+                        game->players[i].holding);
+            }   
+            hub->inRound = true;
+        }
+        if ((player = next_turn(game)) < 0) {
+            //send scores to players, the next round or game is next
+            finish_round(game);
+            send_scores(hub);
+            hub->inRound = false;
+            continue;
+        }
+        // send card to player and wait for their reply
+        hub->askedAt = start_timing();
+        send_message(hub, player, WIRE_YOURTURN, game->given);
+        hub->waiting = player;
+        uint64_t flushed = start_timing();
+        flush_output(hub);
+        stop_timing(&timing.flush, flushed);
+        //the reply cannot be in yet, epoll says when it is
+        arrived = false;
+    }
 }
 
 /*
- * Conducts move with a card that does not require a targetPlayer.
- * Sends appropriate message to standard out and updates child processes.
- * Where:
- * - player: the player who made the move
- * - playedCard: the card that was played 
- */ 
-void no_target_move(int player, char playedCard, struct Game* game) {
-    //Send discard and thishappend message
-    if (playedCard != '8' && playedCard != '1' && playedCard != '3' &&
-            playedCard != '5' && playedCard != '6') {
-        fprintf(stdout, "Player %c discarded %c.\n", player + SHIFT, 
-                playedCard);
-        fflush(stdout);
-        send_this_happened(game, player + SHIFT, playedCard, '-', '-', '-',
-                '-', '-');
-    } 
-    if (playedCard == '8') {
-        //If playedCard was 8, then player is out
-        fprintf(stdout, "Player %c discarded %c. %c was out.\n", 
-                player + SHIFT, playedCard, player + 65);
-        fflush(stdout);
-        send_this_happened(game, player + SHIFT, playedCard, '-', '-',
-                '-', '-', player + SHIFT);
-        game->players[player].outOfRound = true;
+ * Looks at the pipe of a player on shared memory, which only has
+ * something to say once the player has gone. Then whatever the player
+ * left in its ring is taken, and its reader reaches EOF.
+ */
+void check_hangup(Stream* stream) {
+    char discard[64];
+    ssize_t got;
+
+    while ((got = read(stream->read.fd, discard, sizeof(discard))) > 0) {
+    }
+    if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+        fill_reader(&stream->read);
+        stream->read.eof = true;
     }
 }
 
 /*
- * Dispatches the move indicated by the playedCard to the appropraite
- * sub function.
- */ 
-void dispatch_move(struct Game* game, int player, char targetPlayer,
-        char holding, char playedCard, char guess) {
-    switch(playedCard) {
-        case '8':
-            game->players[player].outOfRound = true; 
-            break;
-        case '7': //don'do anything, cases 5 and 6 check if 7 in pref to 5/
-            break; 
-        case '6': //swap cards w`ith target, check if holding 7
-            swap(game, player, targetPlayer, holding, guess); 
-            break; 
-        case '5': //targeted player gets new card, check if hold 7
-            new_card(game, player, targetPlayer, holding, guess); 
-            break; 
-        case '4':
-            game->players[player].protected = true; 
-            break; //player is immune, need to update state
-        case '3': 
-            compare(game, player, targetPlayer, guess); 
-            break;
-        case '2': 
-            break;
-        case '1': 
-            guess_card(game, player, targetPlayer, guess); 
-            break; 
-        default: 
-            //exit as a non-valid card was received
-            safe_exit(game);
-            exit_with(MESSAGE_ERROR);
-            break;
+ * Advances every table whose player has put a reply in its shared memory
+ * ring. Returns true if any had.
+ */
+bool advance_shared(EventLoop* loop) {
+    bool progress = false;
+
+    for (int t = 0; t < loop->numHubs; t++) {
+        struct Hub* hub = &loop->hubs[t];
+        if (hub->waiting >= 0 && hub->pipes[hub->waiting].channel != NULL &&
+                !ring_empty(&hub->pipes[hub->waiting].channel->toHub)) {
+            advance(loop, hub);
+            progress = true;
+        }
     }
+    return progress;
 }
 
 /*
- * Processes a move, updates the player's holding card and sends
- * replace to others as necessary. Where:
- * - given: is the card the player was given
- * - holding: is the card they are holding
- * - player: is the player who needs to be processed
- * - message: is the message received
- */ 
-void process_move(struct Game* game, char given, char holding, 
-        int player, char message[3]) {
-    //the played card is the first char in message
-    char playedCard = message[0];
-    // if they were holding the played card then update the card
-    // they are holding with the one they were given
-    
-    //check if they are not holding the card they played
-    if (game->players[player].holding != playedCard &&
-            given != playedCard) {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
+ * Raises the limit on open files as far as allowed: each table needs
+ * two pipes per player.
+ */
+void raise_file_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
     }
-    if (game->players[player].holding == playedCard) {
-        game->players[player].holding = given;
+}
+
+/*
+ * Sets up the tables of loop, each with its own children running
+ * childProgram, and watches every player's pipe with epoll. Table t
+ * starts on the t-th deck of corpus after the first deck (wrapping
+ * around).
+ */
+void create_tables(EventLoop* loop, int numPlayers,
+        const DeckCorpus* corpus, char** childProgram) {
+    loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+    loop->running = loop->numHubs;
+    if (loop->offerShared) {
+        loop->region = create_region(numPlayers * loop->numHubs,
+                &loop->regionFd);
     }
-    holding = game->players[player].holding;
-
-    //extract targetPlayer and guess from message and check the bounds
-    char targetPlayer = message[1];
-    char guess = message[2];
-    if (targetPlayer != '-' && (targetPlayer < 'A' || targetPlayer > 
-            (game->numPlayers + SHIFT))) {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
+    loop->hubs = calloc(loop->numHubs, sizeof(Hub));
+    children->pid = malloc(sizeof(int) * numPlayers * loop->numHubs);
+
+    for (int t = 0; t < loop->numHubs; t++) {
+        struct Hub* hub = &loop->hubs[t];
+        init_game(&hub->game, numPlayers, corpus,
+                (loop->firstDeck + t) % corpus->numDecks);
+        hub->pipes = calloc(numPlayers, sizeof(Stream));
+        hub->pids = children->pid + t * numPlayers;
+        hub->waiting = -1;
+        hub->offerBinary = loop->offerBinary;
+        hub->firstChannel = t * numPlayers;
+        hub->table = t;
+        uint64_t started = start_timing();
+        create_children(loop, hub, childProgram);
+        stop_timing(&timing.startup, started);
+        for (int i = 0; i < numPlayers; i++) {
+            struct epoll_event event;
+            if (hub->pipes[i].strategy != NULL) {
+                continue;
+            }
+            event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            event.data.u64 = ((uint64_t)t << 8) | i;
+            epoll_ctl(loop->epoll, EPOLL_CTL_ADD, hub->pipes[i].read.fd,
+                    &event);
+        }
     }
-    if (playedCard > '9' || playedCard < '1') {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
+    //with nobody on shared memory, the pipes are all there is
+    bool attached = false;
+    for (int t = 0; t < loop->numHubs; t++) {
+        for (int i = 0; i < numPlayers; i++) {
+            attached = attached || loop->hubs[t].pipes[i].channel != NULL;
+        }
     }
-    if ((guess != '-' && (guess > '9' || guess < '0')) || 
-            ((player + SHIFT) == targetPlayer && playedCard != '5')) {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
+    if (!attached) {
+        loop->region = NULL;
     }
- 
-    //if they were protected then they aren't any more
-    game->players[player].protected = false;
-    //can't target a protected player
-    if (targetPlayer != '-' && 
-            game->players[targetPlayer - SHIFT].protected == true) {
-        safe_exit(game);
-        exit_with(MESSAGE_ERROR);
-    } 
-
-    //dispatch the move to a sub function
-    dispatch_move(game, player, targetPlayer, holding, playedCard, guess);
-    
-    //check if there was no target and act accordingly
-    no_target_move(player, playedCard, game);
 }
 
 /*
- * Send winner information to stdout
- */ 
-void send_winner(struct Game* game) {
-    fprintf(stdout, "Winner(s):");
-    
-    //Progressively build the string
-    for (int i = 0; i < game->numPlayers; i++) {
-        if (game->scores[i] == 4) {
-            fprintf(stdout, " %c", i + SHIFT);
+ * The body of the writer thread: tells the commentary of whatever
+ * records have been queued, every so often or when hurried along, until
+ * the queue is closed. Commentary goes out in big writes, and whenever
+ * the hub goes quiet.
+ */
+void* run_writer(void* arg) {
+    EventQueue* queue = arg;
+    uint32_t tail = queue->tail;
+
+    while (true) {
+        uint32_t seen = bell_count(&queue->bell);
+        bool closed = __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            if (closed) {
+                break;
+            }
+            fflush(stdout);
+            bell_wait(&queue->bell, seen, 0, WRITER_TIMEOUT);
+            continue;
+        }
+        for (; tail != head; tail++) {
+            comment_record(&events.commentary,
+                    &queue->records[tail % QUEUE_SIZE]);
+            __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
         }
     }
-    fprintf(stdout, "\n");
     fflush(stdout);
+    return NULL;
 }
 
 /*
- * Sets the scores for each player according to the cards they are
- * holding and whether they are out of the round
- */ 
-void set_scores(struct Game* game) {
-    /*Initialise the highCard to 1*/
-    char highCard = '1';
-                
-    for (int i = 0; i < game->numPlayers; i++) {
-        //get the highcard
-        if (game->players[i].holding >= highCard &&
-                game->players[i].outOfRound == false) {
-            highCard = game->players[i].holding;
-        }
-    }   
-    //Check if they are not holding the highCard
-    for (int i = 0; i < game->numPlayers; i++) {
-        if(game->players[i].holding != highCard) {
-            game->players[i].outOfRound = true;
+ * Closes the writer thread's queue and waits for it to tell everything
+ * queued. Runs when the hub exits, however it exits.
+ */
+void stop_writer(void) {
+    __atomic_store_n(&events.queue->closed, 1, __ATOMIC_RELEASE);
+    bell_ring(&events.queue->bell);
+    pthread_join(events.writer, NULL);
+}
+
+/*
+ * Sets up where the events of loop's tables go: an event log at logPath
+ * (if not NULL), and the commentary told as mode says. Only done once
+ * the children are running, so none of them has a copy of the log's
+ * buffer or the writer thread.
+ */
+void start_events(EventLoop* loop, const char* logPath, int mode) {
+    events.mode = mode;
+    if (logPath != NULL) {
+        events.log = create_log(logPath, loop->numHubs);
+        if (events.log == NULL) {
+            safe_exit();
+            exit_with(LOG_ERROR);
         }
     }
-    //All who are still in get 1 added to their score
-    for (int i = 0; i < game->numPlayers; i++) {
-        if (!(game->players[i].outOfRound)) {
-            game->scores[i] += 1;
-        }
+    if (mode == COMMENTARY_QUIET) {
+        return;
+    }
+    init_commentary(&events.commentary, stdout, loop->numHubs);
+    if (mode == COMMENTARY_ASYNC) {
+        //nothing else writes to stdout now, so it can be written in bulk
+        setvbuf(stdout, NULL, _IOFBF, WRITER_BUFFER);
+        events.queue = calloc(1, sizeof(EventQueue));
+        //the writer starts with every signal blocked, so SIGINT is only
+        //ever handled on the main thread
+        sigset_t all, old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        pthread_create(&events.writer, NULL, run_writer, events.queue);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        atexit(stop_writer);
     }
 }
 
 /*
- * Runs a single round loop, handing cards to each player still in the
- * round in order, and responding to their messages. Returns boolean
- * to indicate if the round is over (true if it is, false if it is not).
- */ 
-bool run_round(struct Game* game) {
-    /*Variable declarations*/
-    char card; //the card to send to a player
-    bool roundOver = false; //the 
-    char read, message[3];
-
-    //Loop through each player and send them yourturn and process
-    //the response
-    for (int j = 0; j < game->numPlayers; j++) {
-        if (game->players[j].outOfRound == false) {
-            //get next card and check if '-' (means end of deck)
-            if ((card = get_next_card(game)) == '-') {
-                //The round is over, we have finished the deck
-                roundOver = true;
-                break;
+ * Prints the pipe syscalls made by the hub, in total and per turn, to
+ * stderr.
+ */
+void print_syscalls(void) {
+    long total = syscalls.writes + syscalls.reads + syscalls.waits;
+
+    fprintf(stderr, "turns %ld\n", syscalls.turns);
+    fprintf(stderr, "writes %ld\n", syscalls.writes);
+    fprintf(stderr, "reads %ld\n", syscalls.reads);
+    fprintf(stderr, "waits %ld\n", syscalls.waits);
+    fprintf(stderr, "syscalls/turn %.2f\n",
+            syscalls.turns > 0 ? (double)total / syscalls.turns : 0.0);
+}
+
+/*
+ * Waits for a player on shared memory to reply, spinning and then
+ * sleeping on the bell all of them ring. Returns the epoll timeout to
+ * look at the pipes with afterwards: none if the bell rang and every
+ * player is on shared memory.
+ */
+int wait_shared(EventLoop* loop) {
+    Bell* bell = &loop->region->bell;
+    uint32_t seen = bell_count(bell);
+
+    //a reply that is in already needs no waiting
+    if (advance_shared(loop)) {
+        return loop->pipePlayers > 0 ? 0 : -1;
+    }
+    int rung = bell_wait(bell, seen, loop->spins,
+            loop->pipePlayers > 0 ? MIXED_TIMEOUT : SHM_TIMEOUT);
+    if (rung != BELL_SPUN) {
+        syscalls.waits++;
+    }
+    return rung == BELL_TIMEOUT || loop->pipePlayers > 0 ? 0 : -1;
+}
+
+/*
+ * Runs every table until all of the games have been played. Each table
+ * is advanced whenever the player it is waiting on has replied. Exits
+ * once every table is done.
+ */
+void play_games(EventLoop* loop) {
+    struct epoll_event events[MAX_EVENTS];
+
+    for (int t = 0; t < loop->numHubs; t++) {
+        if (next_game(loop, &loop->hubs[t])) {
+            advance(loop, &loop->hubs[t]);
+        }
+    }
+    while (loop->running > 0) {
+        int ready;
+        if (loop->region != NULL) {
+            //the pipes only matter once in a while with shared memory
+            int timeout = wait_shared(loop);
+            if (timeout < 0) {
+                continue;
             }
-            // send card to player
-            fprintf(game->pipes[j].write, "yourturn %c\n", card);
-            fflush(game->pipes[j].write);
-            int k = 0;
-            read = fgetc(game->pipes[j].read);
-            
-            //loop through and get message from the player
-            while(read != EOF && read != '\n') {
-                //if k is 3 and read not \n then message from player
-                //was no of form c1pc2 so exit with MESSAGE_ERROR
-                if (k == 3 && read != '\n') {
-                    safe_exit(game);
-                    exit_with(MESSAGE_ERROR);
-                } 
-                message[k++] = read;
-                read = fgetc(game->pipes[j].read);
+            ready = epoll_wait(loop->epoll, events, MAX_EVENTS, timeout);
+        } else {
+            ready = epoll_wait(loop->epoll, events, MAX_EVENTS, -1);
+        }
+        syscalls.waits++;
+        for (int e = 0; e < ready; e++) {
+            struct Hub* hub = &loop->hubs[events[e].data.u64 >> 8];
+            int player = events[e].data.u64 & 0xff;
+            if (hub->pipes[player].channel != NULL) {
+                check_hangup(&hub->pipes[player]);
             }
-            //if read was EOF then a player quit
-            if (read == EOF) {
-                safe_exit(game);
-                exit_with(QUIT_ERROR);
-            }
-            //process the move
-            process_move(game, card, game->players[j].holding, 
-                    j, message);
-            //check for outOfRound
-            roundOver = check_end_of_round(game);
-            if (roundOver) {
-                set_scores(game);
-                break;
+            //keep anything sent early, it is used when wanted
+            if (hub->waiting == player) {
+                advance(loop, hub);
+            } else if (hub->pipes[player].channel == NULL) {
+                fill_reader(&hub->pipes[player].read);
             }
         }
     }
-    return roundOver;
+    if (loop->countSyscalls) {
+        print_syscalls();
+    }
+    if (timing.path != NULL) {
+        write_stats(loop);
+    }
+    exit_with(NORMAL_EXIT);
 }
 
 /*
- * Runs the overall game. Loops until a player reachs four points.
+ * Returns the corpus of the deck file at path, read as it is wanted if
+ * stream (standard input if path is "-"), wrapping around at its end if
+ * wrap. Exits with ACCESS_ERROR if it cannot be opened, and DECK_ERROR
+ * if it is not a deck file.
  */
-void play_game(struct Game* game) {
-    //check if there is a winner
-    bool winner = is_winner(game);
-    
-    //while two players still not eliminated  
-    while (winner == false) {
-        // set up bool to check end of round
-        //send newround to each player
-        char card;
-
-        //start of a new round
-        for(int i = 0; i < game->numPlayers; i++) {
-            // if pos > 15 we need to reset otherwise out of bounds 
-            game->players[i].outOfRound = false; //no one is out
-            game->players[i].protected = false; //no one is protected
-            card = get_next_card(game); //get the next card
-            fprintf(game->pipes[i].write, "newround %c\n", 
-                    card);  //give each player their card
-            fflush(game->pipes[i].write); //fflush monkey
-            game->players[i].holding = card;
-        }   
-        
-        //check if roundOver
-        bool roundOver = check_end_of_round(game);
-        while(roundOver == false) {
-            //send yourturn to each player in order and process their move
-            roundOver = run_round(game); 
+DeckCorpus* open_corpus(const char* path, bool stream, bool wrap) {
+    if (stream) {
+        int fd = strcmp(path, "-") == 0 ? STDIN_FILENO :
+                open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            exit_with(ACCESS_ERROR);
         }
-        game->deck = game->deck->nextDeck;
-        game->deck->pos = 1;
-        //send scores to players and check if there is a game winner
-        send_scores(game);
-        winner = is_winner(game);
+        return stream_decks(fd, wrap);
     }
-    // send Winners message
-    send_winner(game);
-    
-    //send gameover set each child, and then to be sure, kill them
-    int childStatus;
-    for (int i = 0; i < game->numPlayers; i++) {
-        fprintf(game->pipes[i].write, "gameover\n");
-        fflush(game->pipes[i].write);
-        kill(children->pid[i], SIGKILL);
-        waitpid(children->pid[i], &childStatus, 0); 
+    FILE* deckFile = fopen(path, "r");
+    if (deckFile == NULL) {
+        exit_with(ACCESS_ERROR);
     }
-    exit_with(NORMAL_EXIT);
+    DeckCorpus* corpus = load_decks(deckFile);
+    fclose(deckFile);
+    if (corpus == NULL) {
+        exit_with(DECK_ERROR);
+    }
+    return corpus;
 }
 
 /*
  * The main function
  */ 
 int main(int argc, char** argv) {
+    EventLoop loop = {0}; //the tables and how many games to play
+    char* logPath = NULL; //where to log events, if anywhere
+    int commentary = COMMENTARY_SYNC; //how to tell the commentary
+    bool seeded = false; //true to generate decks instead of a deckfile
+    uint64_t seed = 0; //the seed to generate decks from
+    long numDecks = LONG_MAX; //how many decks to generate before repeating
+    bool stream = false; //true to read the deckfile as decks are wanted
+    bool wrap = false; //true to deal a streamed deckfile again at its end
+    struct option longOptions[] = {
+        {"quiet", no_argument, NULL, 'q'},
+        {"seed", required_argument, NULL, OPTION_SEED},
+        {"decks", required_argument, NULL, OPTION_DECKS},
+        {"stream", no_argument, NULL, OPTION_STREAM},
+        {"wrap", no_argument, NULL, OPTION_WRAP},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    
     initialise_handler();
-    if (argc < 4 || argc > 6) {
+    loop.numGames = 1;
+    loop.numHubs = 1;
+    opterr = 0; //only ever print our own usage message
+    while ((opt = getopt_long(argc, argv, "+bsmp:g:c:d:l:t:aq",
+            longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                loop.offerBinary = true;
+                break;
+            case 's':
+                loop.countSyscalls = true;
+                break;
+            case 'm':
+                loop.offerShared = true;
+                break;
+            case 'p':
+                loop.spins = atoi(optarg);
+                break;
+            case 'g':
+                loop.numGames = atol(optarg);
+                break;
+            case 'c':
+                loop.numHubs = atoi(optarg);
+                break;
+            case 'd':
+                loop.firstDeck = atol(optarg);
+                break;
+            case 'l':
+                logPath = optarg;
+                break;
+            case 't':
+                timing.path = optarg;
+                break;
+            case 'a':
+                commentary = COMMENTARY_ASYNC;
+                break;
+            case 'q':
+                commentary = COMMENTARY_QUIET;
+                break;
+            case OPTION_SEED:
+                seeded = true;
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case OPTION_DECKS:
+                numDecks = atol(optarg);
+                break;
+            case OPTION_STREAM:
+                stream = true;
+                break;
+            case OPTION_WRAP:
+                wrap = true;
+                break;
+            default:
+                exit_with(USAGE_ERROR);
+        }
+    }
+    //optind is the deckfile (unless decks are generated), the rest are
+    //the players
+    int numPlayers = argc - optind - (seeded ? 0 : 1);
+    if (numPlayers < MIN_PLAYERS || numPlayers > MAX_PLAYERS ||
+            loop.numGames < 1 || loop.numHubs < 1 || loop.spins < 0 ||
+            loop.firstDeck < 0 || numDecks < 1 ||
+            (stream && seeded) || (wrap && !stream)) {
         exit_with(USAGE_ERROR);
     }
- 
-    //get the chosenFile from the input
-    char* chosenFile = argv[1];
-    FILE* deckFile = fopen(chosenFile, "r");
-    Deck* deck = get_list_decks(deckFile);
-    fclose(deckFile);
-    
-    //create enough space of the array of childPrograms
-    char** childProgram = malloc((argc - 2) * sizeof(char*));
-    //add process args to childProgram
-    for (int j = 2; j < (argc); j++) {
-        childProgram[j - 2] = argv[j];
+    //spinning on the only core just keeps the player off it
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        loop.spins = 0;
     }
-
-    //generate the game struct
-    struct Game* game = malloc(sizeof(Game));
-    game->round = 0; //initialise to round 0
-    game->numPlayers = argc - 2; //set numPlayers
-    game->deck = malloc(sizeof(Deck)); 
-    game->deck = deck; //set deck(s) to use
-    game->scores = malloc(sizeof(int) * (game->numPlayers)); //malscores  
-    //array
-    for (int i = 0; i < game->numPlayers; i++) {
-        game->scores[i] = 0; //initialise all scores to 0
+    //no more tables than games
+    if (loop.numHubs > loop.numGames) {
+        loop.numHubs = loop.numGames;
+    }
+ 
+    //get the decks from the chosen file, or make them up as they come
+    DeckCorpus* corpus = seeded ? generate_decks(seed, numDecks) :
+            open_corpus(argv[optind], stream, wrap);
+    //a stream has no deck numbers, so -d skips that many of its decks
+    Deck skipped;
+    for (long i = 0; stream && i < loop.firstDeck; i++) {
+        if (!get_deck(corpus, i, &skipped)) {
+            exit_with(DECK_ERROR);
+        }
     }
-    //create space for pipes and players
-    game->pipes = malloc(sizeof(Stream) * (game->numPlayers)); 
-    game->players = malloc(sizeof(Player) * (game->numPlayers)); 
     
     //Set up the children global variable to contain pid information on
-    //players
+    //players, filled in as they are made
     children = malloc(sizeof(ChildProcesses));
-    children->pid = malloc(sizeof(int) * game->numPlayers);
-    children->numChildren = game->numPlayers;
+    children->numChildren = 0;
     
-    //make children
-    create_children(game, childProgram);
-    //play the game
-    play_game(game);    
+    //make the tables and their children, then play
+    raise_file_limit();
+    create_tables(&loop, numPlayers, corpus, argv + argc - numPlayers);
+    //the stats file starts out with the startup times
+    if (timing.path != NULL && (asprintf(&timing.temp, "%s.tmp",
+            timing.path) < 0 || !write_stats(&loop))) {
+        safe_exit();
+        exit_with(STATS_ERROR);
+    }
+    start_events(&loop, logPath, commentary);
+    play_games(&loop);    
     return 0;
 }
@@ -0,0 +1,215 @@
+/*
+ * The hubbench program
+ *
+ * Runs the hub through a standard set of scenarios and reports how fast
+ * it played, so runs on different commits can be compared line by line.
+ * For 2, 3 and 4 players it plays:
+ * - single: one game, players started for it
+ * - cold: many games, each in a hub of its own, so the players are
+ *   started for every game
+ * - warm: as many games in one hub, so the players are started once
+ * Commentary is turned off, and the hub counts its syscalls (-s).
+ *
+ * Each scenario is one line under a header naming the columns: the
+ * scenario, the number of players, games and turns, the seconds taken,
+ * games and turns per second, syscalls per turn and the peak resident
+ * set size (in KB) of the hub or any of its players. Fields are
+ * separated by single spaces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "loveletter.h"
+
+/*Error exit statuses*/
+#define NORMAL_EXIT 0
+#define USAGE_ERROR 1
+#define ACCESS_ERROR 2
+#define HUB_ERROR 3
+/* The header line of the report */
+#define COLUMNS "scenario players games turns seconds games/sec " \
+        "turns/sec syscalls/turn maxrss"
+/* The most arguments the hub is run with */
+#define MAX_ARGS (9 + MAX_PLAYERS)
+
+/* What some runs of the hub added up to
+ * - games: the games played
+ * - turns: the turns taken
+ * - syscalls: the pipe syscalls the hub made
+ * - seconds: the time the runs took, from start to exit
+ * - maxRss: the peak resident set size of any process, in KB
+ */
+typedef struct Totals {
+    long games;
+    long turns;
+    long syscalls;
+    double seconds;
+    long maxRss;
+} Totals;
+
+/*
+ * Exits the process with the given exitStatus.
+ */
+void exit_with(int exitStatus) {
+    switch(exitStatus) {
+        case 1:
+            fprintf(stderr, "Usage: hubbench [-n games] deckfile hub "
+                    "player\n");
+            break;
+        case 2:
+            fprintf(stderr, "Unable to access deckfile\n");
+            break;
+        case 3:
+            fprintf(stderr, "Hub failed\n");
+            break;
+        default:
+            break;
+    }
+    exit(exitStatus);
+}
+
+/*
+ * Adds up the counts in the -s report the hub wrote to report.
+ */
+void read_report(FILE* report, Totals* totals) {
+    char name[32];
+    double value;
+
+    while (fscanf(report, "%31s %lf", name, &value) == 2) {
+        if (strcmp(name, "turns") == 0) {
+            totals->turns += value;
+        } else if (strcmp(name, "writes") == 0 ||
+                strcmp(name, "reads") == 0 || strcmp(name, "waits") == 0) {
+            totals->syscalls += value;
+        }
+    }
+}
+
+/*
+ * Runs hub with args (a NULL terminated argv) until it exits, adding
+ * what it did to totals. Exits with HUB_ERROR if it fails.
+ */
+void run_hub(char** args, long games, Totals* totals) {
+    struct timespec start, end;
+    struct rusage usage;
+    int report[2];
+    int status;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (pipe(report) == -1) {
+        exit_with(HUB_ERROR);
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        exit_with(HUB_ERROR);
+    } else if (pid == 0) {
+        //the commentary is off, anything left goes nowhere
+        int bitBucket = open("/dev/null", O_WRONLY);
+        dup2(bitBucket, STDOUT_FILENO);
+        dup2(report[1], STDERR_FILENO);
+        close(report[0]);
+        execv(args[0], args);
+        exit(HUB_ERROR);
+    }
+    close(report[1]);
+    FILE* reportFile = fdopen(report[0], "r");
+    read_report(reportFile, totals);
+    fclose(reportFile);
+    //wait4 counts the players the hub waited on in the peak too
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != NORMAL_EXIT) {
+        exit_with(HUB_ERROR);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    totals->games += games;
+    totals->seconds += (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (usage.ru_maxrss > totals->maxRss) {
+        totals->maxRss = usage.ru_maxrss;
+    }
+}
+
+/*
+ * Plays a scenario: runs hubs, each one playing games games of
+ * numPlayers players with decks from deckfile, and prints its line. Each
+ * run starts on the deck after the last run's first deck, so cold runs
+ * do not all play the same game.
+ */
+void run_scenario(const char* name, int numPlayers, long runs, long games,
+        char* deckfile, char* hub, char* player) {
+    char gameCount[32];
+    char firstDeck[32];
+    char* args[MAX_ARGS];
+    int numArgs = 0;
+    Totals totals;
+
+    memset(&totals, 0, sizeof(Totals));
+    sprintf(gameCount, "%ld", games);
+    args[numArgs++] = hub;
+    args[numArgs++] = "-s";
+    args[numArgs++] = "-q";
+    args[numArgs++] = "-g";
+    args[numArgs++] = gameCount;
+    args[numArgs++] = "-d";
+    args[numArgs++] = firstDeck;
+    args[numArgs++] = deckfile;
+    for (int i = 0; i < numPlayers; i++) {
+        args[numArgs++] = player;
+    }
+    args[numArgs] = NULL;
+    for (long r = 0; r < runs; r++) {
+        sprintf(firstDeck, "%ld", r);
+        run_hub(args, games, &totals);
+    }
+    fprintf(stdout, "%s %d %ld %ld %.3f %.0f %.0f %.2f %ld\n", name,
+            numPlayers, totals.games, totals.turns, totals.seconds,
+            totals.games / totals.seconds, totals.turns / totals.seconds,
+            totals.turns > 0 ? (double)totals.syscalls / totals.turns : 0.0,
+            totals.maxRss);
+    fflush(stdout);
+}
+
+/*
+ * The main function
+ */
+int main(int argc, char** argv) {
+    long numGames = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                numGames = atol(optarg);
+                break;
+            default:
+                exit_with(USAGE_ERROR);
+        }
+    }
+    if (argc - optind != 3 || numGames < 1) {
+        exit_with(USAGE_ERROR);
+    }
+    char* deckfile = argv[optind];
+    char* hub = argv[optind + 1];
+    char* player = argv[optind + 2];
+    if (access(deckfile, R_OK) != 0) {
+        exit_with(ACCESS_ERROR);
+    }
+
+    fprintf(stdout, "%s\n", COLUMNS);
+    for (int n = MIN_PLAYERS; n <= MAX_PLAYERS; n++) {
+        //a cold game costs far more, so fewer of them are played
+        run_scenario("single", n, 1, 1, deckfile, hub, player);
+        run_scenario("cold", n, (numGames + 9) / 10, 1, deckfile, hub,
+                player);
+        run_scenario("warm", n, 1, numGames, deckfile, hub, player);
+    }
+    return NORMAL_EXIT;
+}
@@ -0,0 +1,734 @@
+/*
+ * The ismcts strategy: information set Monte Carlo tree search
+ * (libloveletter)
+ *
+ * Each turn the seat searches until a fixed share of its time budget has
+ * gone. Every iteration first deals out the cards the seat cannot see in
+ * a way that fits everything it has been told (a determinization), then
+ * walks a tree of the seat's own moves: at each node only the moves
+ * possible in that deal are weighed, each by how often it has won against
+ * how often it has been possible. The first move not yet in the tree is
+ * added, a quick playout finishes the round, and each move on the path is
+ * scored by whether the seat won. Moves are played by the engine, so the
+ * rules are its own.
+ *
+ * Opponents play the playout's moves throughout rather than being
+ * searched for: every deal gives the seat its real hand, so an opponent
+ * choosing by the tree would learn that hand and guess it every time.
+ *
+ * The search runs on a pool of threads that each grow their own tree
+ * from the same knowledge (root parallelisation), so nothing is shared
+ * while they search. Once the deadline passes every thread stops after
+ * its current iteration, and the move most visited across all the trees
+ * is played. A move with no choice is played at once.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "loveletter.h"
+#include "latency.h"
+
+/* The most threads searching for a seat */
+#define MAX_THREADS 8
+/* The nodes of each thread's tree; once full, it stops growing */
+#define MAX_NODES 32768
+/* More than the moves a seat can have */
+#define MAX_MOVES 64
+/* How far the search favours moves it knows less about */
+#define EXPLORATION 0.7
+/* Tenths of the budget to search for, leaving the rest for replying */
+#define SEARCH_TENTHS 9
+/* Card sets: bit c is set for card c */
+#define ALL_CARDS 0x1fe
+#define CARD_BIT(c) (1 << ((c) - '0'))
+/* xorshift64* */
+#define RANDOM_MULTIPLIER 0x2545f4914f6cdd1dULL
+
+/* What a seat knows of the round. Cards are chars ('1' to '8'), 0 for
+ * none.
+ * - seat: the seat's index
+ * - numPlayers: the number of players
+ * - hand: the card the seat holds
+ * - given: the card dealt to the seat for the turn it is deciding
+ * - givenAway: the card held before the last replace
+ * - pos: the deck position, as the engine has it between turns
+ * - played: copies of each card seen played, dropped or named by a
+ *   right guess
+ * - out: each seat being out of the round
+ * - protected: each seat being protected
+ * - possible: the cards each seat may hold
+ * - known: the card each seat is known to hold, or 0
+ * - shown: each seat whose card needs no dealing, having been counted in
+ *   played, or being the next card of the deck over again
+ */
+typedef struct Knowledge {
+    int seat;
+    int numPlayers;
+    char hand;
+    char given;
+    char givenAway;
+    int pos;
+    int played[9];
+    bool out[MAX_PLAYERS];
+    bool protected[MAX_PLAYERS];
+    int possible[MAX_PLAYERS];
+    char known[MAX_PLAYERS];
+    bool shown[MAX_PLAYERS];
+} Knowledge;
+
+/* A move in a search tree, made from its parent
+ * - move: the move (c1pc2)
+ * - visits: the iterations that made it
+ * - available: the iterations it could have been made in
+ * - wins: the iterations the seat won the round in
+ * - child: its first child, or -1
+ * - sibling: its parent's next child, or -1
+ */
+typedef struct Node {
+    char move[3];
+    int visits;
+    int available;
+    float wins;
+    int child;
+    int sibling;
+} Node;
+
+/* A thread of the search and its tree
+ * - owner: the seat's state
+ * - thread: the thread (none for the first worker, which is the caller)
+ * - random: its random number state
+ * - nodes: its tree, the root first
+ * - numNodes: the nodes in use
+ */
+typedef struct Worker {
+    struct Ismcts* owner;
+    pthread_t thread;
+    uint64_t random;
+    Node* nodes;
+    int numNodes;
+} Worker;
+
+/* The state of a seat played by the ismcts strategy
+ * - knowledge: what it knows of the round
+ * - budget: the time allowed for each move, in nanoseconds
+ * - deadline: when the search in progress stops, on the clock of
+ *   now_nanos
+ * - workers: one per thread of the pool
+ * - numWorkers: the number of workers
+ * - lock: protects generation, running and quit
+ * - wake: signalled when there is a search to join, or the pool is to
+ *   quit
+ * - done: signalled when the last worker finishes a search
+ * - generation: the searches started so far
+ * - running: the pool threads still searching
+ * - quit: true when the pool threads are to exit
+ */
+typedef struct Ismcts {
+    Knowledge knowledge;
+    uint64_t budget;
+    uint64_t deadline;
+    Worker workers[MAX_THREADS];
+    int numWorkers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t generation;
+    int running;
+    bool quit;
+} Ismcts;
+
+/*
+ * Returns the next random number of random.
+ */
+static uint64_t next_random(uint64_t* random) {
+    *random ^= *random >> 12;
+    *random ^= *random << 25;
+    *random ^= *random >> 27;
+    return *random * RANDOM_MULTIPLIER;
+}
+
+/*
+ * Returns a random number from 0 to bound - 1.
+ */
+static int random_below(uint64_t* random, int bound) {
+    return ((next_random(random) >> 32) * bound) >> 32;
+}
+
+/*
+ * Sets game to a deal of the round that fits knowledge, dealt to its
+ * seat for the turn it is deciding: the seat's cards are its own, and
+ * every card it has not seen is shuffled into the others' hands (as far
+ * as what they may hold allows), the rest of the deck and the card set
+ * aside.
+ */
+static void determinize(const Knowledge* knowledge, uint64_t* random,
+        Game* game) {
+    int left[9];
+    char pool[DECK_SIZE];
+    int numPool = 0;
+    int seat = knowledge->seat;
+
+    for (int v = 1; v <= 8; v++) {
+        left[v] = cardCopies[v] - knowledge->played[v];
+    }
+    left[knowledge->hand - '0']--;
+    left[knowledge->given - '0']--;
+    for (int p = 0; p < knowledge->numPlayers; p++) {
+        if (p != seat && !knowledge->shown[p] && knowledge->known[p]) {
+            left[knowledge->known[p] - '0']--;
+        }
+    }
+    for (int v = 1; v <= 8; v++) {
+        for (int i = 0; i < left[v] && numPool < DECK_SIZE; i++) {
+            pool[numPool++] = '0' + v;
+        }
+    }
+    for (int i = numPool - 1; i > 0; i--) {
+        int j = random_below(random, i + 1);
+        char card = pool[i];
+        pool[i] = pool[j];
+        pool[j] = card;
+    }
+
+    memset(game, 0, sizeof(Game));
+    game->numPlayers = knowledge->numPlayers;
+    game->pos = knowledge->pos + 1; //past the card just dealt
+    game->turn = seat;
+    game->given = knowledge->given;
+    for (int p = 0; p < knowledge->numPlayers; p++) {
+        Player* player = &game->players[p];
+        player->label = p + SHIFT;
+        player->outOfRound = knowledge->out[p];
+        player->protected = knowledge->protected[p];
+        if (p == seat) {
+            player->holding = knowledge->hand;
+        } else if (knowledge->shown[p]) {
+            //out of the round, so never looked at
+            player->holding = '1';
+        } else if (knowledge->known[p]) {
+            player->holding = knowledge->known[p];
+        } else {
+            //the last card of the pool they may hold, or any if none
+            int pick = numPool - 1;
+            while (pick > 0 &&
+                    !(knowledge->possible[p] & CARD_BIT(pool[pick]))) {
+                pick--;
+            }
+            player->holding = numPool > 0 ? pool[pick] : '1';
+            if (numPool > 0) {
+                pool[pick] = pool[--numPool];
+            }
+        }
+    }
+    //what is left is the rest of the deck, then the card set aside
+    for (int k = game->pos; k <= DECK_SIZE; k++) {
+        game->deck.cards[k % DECK_SIZE] = numPool > 0 ? pool[--numPool] :
+                '1';
+    }
+}
+
+/*
+ * Adds the move card target guess to the numMoves moves in moves.
+ */
+static void add_move(char moves[][3], int* numMoves, char card,
+        char target, char guess) {
+    moves[*numMoves][0] = card;
+    moves[*numMoves][1] = target;
+    moves[*numMoves][2] = guess;
+    (*numMoves)++;
+}
+
+/*
+ * Lists the moves of seat, just dealt a card in game, into moves and
+ * returns how many there are. Only seats in the round are aimed at; a 1
+ * may guess any card it can.
+ */
+static int list_moves(const Game* game, int seat, char moves[][3]) {
+    const Player* players = game->players;
+    char cards[2] = {players[seat].holding, game->given};
+    int numMoves = 0;
+
+    for (int c = 0; c < 2 && (c == 0 || cards[1] != cards[0]); c++) {
+        char card = cards[c];
+        //a 5 or 6 cannot be played keeping a 7
+        if ((card == '5' || card == '6') && cards[1 - c] == '7') {
+            continue;
+        }
+        if (card != '1' && card != '3' && card != '5' && card != '6') {
+            add_move(moves, &numMoves, card, '-', '-');
+            continue;
+        }
+        int aimed = numMoves;
+        for (int t = 0; t < game->numPlayers; t++) {
+            if (t == seat || players[t].outOfRound || players[t].protected) {
+                continue;
+            }
+            if (card != '1') {
+                add_move(moves, &numMoves, card, t + SHIFT, '-');
+                continue;
+            }
+            for (char guess = '2'; guess <= '8'; guess++) {
+                add_move(moves, &numMoves, card, t + SHIFT, guess);
+            }
+        }
+        //a 5 may always aim at its player; the rest aim at nobody if
+        //there is nobody to aim at
+        if (card == '5') {
+            add_move(moves, &numMoves, card, seat + SHIFT, '-');
+        } else if (numMoves == aimed) {
+            add_move(moves, &numMoves, card, '-', '-');
+        }
+    }
+    return numMoves;
+}
+
+/*
+ * Writes the move of seat, just dealt a card in game, in a playout: the
+ * basic strategy's card, aimed at a random seat that can be aimed at,
+ * guessing a random card.
+ */
+static void playout_move(const Game* game, int seat, uint64_t* random,
+        char move[3]) {
+    const Player* players = game->players;
+    char first = players[seat].holding;
+    char second = game->given;
+    int targets[MAX_PLAYERS];
+    int numTargets = 0;
+
+    if (first == '7' && (second == '5' || second == '6')) {
+        move[0] = first;
+    } else if (second == '7' && (first == '5' || first == '6')) {
+        move[0] = second;
+    } else {
+        move[0] = first < second ? first : second;
+    }
+    move[1] = '-';
+    move[2] = '-';
+    if (move[0] != '1' && move[0] != '3' && move[0] != '5' &&
+            move[0] != '6') {
+        return;
+    }
+    for (int t = 0; t < game->numPlayers; t++) {
+        if (t != seat && !players[t].outOfRound && !players[t].protected) {
+            targets[numTargets++] = t;
+        }
+    }
+    if (numTargets > 0) {
+        move[1] = targets[random_below(random, numTargets)] + SHIFT;
+        if (move[0] == '1') {
+            move[2] = '2' + random_below(random, 7);
+        }
+    } else if (move[0] == '5') {
+        move[1] = seat + SHIFT;
+    }
+}
+
+/*
+ * Picks the move of seat, just dealt a card in game, at node of worker's
+ * tree, writing it to move: a move never tried there if there is one
+ * (added to the tree if it has room), else the one of those possible
+ * with the best bound on its wins. Returns the node of the
+ * move, or -1 if it is not in the tree.
+ */
+static int select_move(Worker* worker, int node, const Game* game,
+        int seat, char move[3]) {
+    Node* nodes = worker->nodes;
+    char moves[MAX_MOVES][3];
+    bool tried[MAX_MOVES];
+    int numMoves = list_moves(game, seat, moves);
+    int numUntried = numMoves;
+    int best = -1;
+    double bestScore = 0;
+
+    memset(tried, 0, sizeof(tried));
+    for (int c = nodes[node].child; c >= 0; c = nodes[c].sibling) {
+        for (int m = 0; m < numMoves; m++) {
+            if (!tried[m] && memcmp(moves[m], nodes[c].move, 3) == 0) {
+                tried[m] = true;
+                numUntried--;
+                nodes[c].available++;
+                double score = nodes[c].wins / nodes[c].visits +
+                        EXPLORATION * sqrt(log(nodes[c].available) /
+                        nodes[c].visits);
+                if (best < 0 || score > bestScore) {
+                    best = c;
+                    bestScore = score;
+                }
+                break;
+            }
+        }
+    }
+    if (numUntried == 0) {
+        memcpy(move, nodes[best].move, 3);
+        return best;
+    }
+    int pick = random_below(&worker->random, numUntried);
+    for (int m = 0; m < numMoves; m++) {
+        if (!tried[m] && pick-- == 0) {
+            memcpy(move, moves[m], 3);
+        }
+    }
+    if (worker->numNodes == MAX_NODES) {
+        return -1;
+    }
+    Node* child = &nodes[worker->numNodes];
+    memcpy(child->move, move, 3);
+    child->visits = 0;
+    child->available = 1;
+    child->wins = 0;
+    child->child = -1;
+    child->sibling = nodes[node].child;
+    nodes[node].child = worker->numNodes;
+    return worker->numNodes++;
+}
+
+/*
+ * Runs one iteration of worker's search: deals the round out, follows
+ * the tree down to a new move, plays the round out and scores the path.
+ */
+static void run_iteration(Worker* worker, const Knowledge* knowledge) {
+    Node* nodes = worker->nodes;
+    int path[2 * DECK_SIZE];
+    int depth = 0;
+    int node = 0;
+    Outcome outcome;
+    char move[3];
+    Game game;
+
+    determinize(knowledge, &worker->random, &game);
+    int seat = knowledge->seat;
+    while (seat >= 0) {
+        if (node >= 0 && seat == knowledge->seat) {
+            //a new node ends the walk down the tree
+            bool fresh = node == 0 || nodes[node].visits > 0;
+            node = fresh ? select_move(worker, node, &game, seat, move) :
+                    -1;
+            if (node >= 0) {
+                path[depth++] = node;
+            }
+        }
+        if (node < 0 || seat != knowledge->seat) {
+            playout_move(&game, seat, &worker->random, move);
+        }
+        if (apply_move(&game, seat, move, &outcome) != MOVE_OK) {
+            return;
+        }
+        seat = next_turn(&game);
+    }
+    //scoring has put everyone but the winners out
+    bool won = !game.players[knowledge->seat].outOfRound;
+    nodes[0].visits++;
+    for (int d = 0; d < depth; d++) {
+        Node* step = &nodes[path[d]];
+        step->visits++;
+        step->wins += won;
+    }
+}
+
+/*
+ * Grows a new tree for worker from its owner's knowledge until the
+ * deadline.
+ */
+static void search(Worker* worker) {
+    Ismcts* ismcts = worker->owner;
+
+    memset(&worker->nodes[0], 0, sizeof(Node));
+    worker->nodes[0].child = -1;
+    worker->nodes[0].sibling = -1;
+    worker->numNodes = 1;
+    while (now_nanos() < ismcts->deadline) {
+        run_iteration(worker, &ismcts->knowledge);
+    }
+}
+
+/*
+ * The body of each pool thread: joins every search started until the
+ * pool is to quit.
+ */
+static void* run_pool(void* arg) {
+    Worker* worker = arg;
+    Ismcts* ismcts = worker->owner;
+    uint64_t joined = 0;
+
+    pthread_mutex_lock(&ismcts->lock);
+    while (true) {
+        while (!ismcts->quit && ismcts->generation == joined) {
+            pthread_cond_wait(&ismcts->wake, &ismcts->lock);
+        }
+        if (ismcts->quit) {
+            break;
+        }
+        joined = ismcts->generation;
+        pthread_mutex_unlock(&ismcts->lock);
+        search(worker);
+        pthread_mutex_lock(&ismcts->lock);
+        if (--ismcts->running == 0) {
+            pthread_cond_signal(&ismcts->done);
+        }
+    }
+    pthread_mutex_unlock(&ismcts->lock);
+    return NULL;
+}
+
+/*
+ * Returns the number the environment variable name is set to, or
+ * fallback if it is not set to a positive number.
+ */
+static long read_setting(const char* name, long fallback) {
+    char* value = getenv(name);
+    long setting = value != NULL ? atol(value) : 0;
+
+    return setting > 0 ? setting : fallback;
+}
+
+/*
+ * Makes the state for a seat, with its thread pool.
+ */
+static void* ismcts_create(int numPlayers, char label) {
+    Ismcts* ismcts = calloc(1, sizeof(Ismcts));
+
+    ismcts->knowledge.seat = label - SHIFT;
+    ismcts->knowledge.numPlayers = numPlayers;
+    ismcts->budget = read_setting(ISMCTS_BUDGET_ENV, ISMCTS_BUDGET) * 1000;
+    ismcts->numWorkers = read_setting(ISMCTS_THREADS_ENV,
+            sysconf(_SC_NPROCESSORS_ONLN));
+    if (ismcts->numWorkers > MAX_THREADS) {
+        ismcts->numWorkers = MAX_THREADS;
+    } else if (ismcts->numWorkers < 1) {
+        ismcts->numWorkers = 1;
+    }
+    pthread_mutex_init(&ismcts->lock, NULL);
+    pthread_cond_init(&ismcts->wake, NULL);
+    pthread_cond_init(&ismcts->done, NULL);
+    for (int i = 0; i < ismcts->numWorkers; i++) {
+        Worker* worker = &ismcts->workers[i];
+        worker->owner = ismcts;
+        worker->random = (now_nanos() + i * GOLDEN) | 1;
+        worker->nodes = malloc(MAX_NODES * sizeof(Node));
+        if (i > 0) {
+            pthread_create(&worker->thread, NULL, run_pool, worker);
+        }
+    }
+    return ismcts;
+}
+
+/*
+ * Stops the seat's thread pool and frees its state.
+ */
+static void ismcts_destroy(void* state) {
+    Ismcts* ismcts = state;
+
+    pthread_mutex_lock(&ismcts->lock);
+    ismcts->quit = true;
+    pthread_cond_broadcast(&ismcts->wake);
+    pthread_mutex_unlock(&ismcts->lock);
+    for (int i = 0; i < ismcts->numWorkers; i++) {
+        if (i > 0) {
+            pthread_join(ismcts->workers[i].thread, NULL);
+        }
+        free(ismcts->workers[i].nodes);
+    }
+    pthread_mutex_destroy(&ismcts->lock);
+    pthread_cond_destroy(&ismcts->wake);
+    pthread_cond_destroy(&ismcts->done);
+    free(ismcts);
+}
+
+/*
+ * newround: hold only card, with nothing known of anyone else.
+ */
+static void ismcts_newround(void* state, char card) {
+    Knowledge* knowledge = &((Ismcts*)state)->knowledge;
+
+    memset(knowledge->played, 0, sizeof(knowledge->played));
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        knowledge->out[p] = false;
+        knowledge->protected[p] = false;
+        knowledge->possible[p] = ALL_CARDS;
+        knowledge->known[p] = 0;
+        knowledge->shown[p] = false;
+    }
+    knowledge->hand = card;
+    knowledge->given = 0;
+    knowledge->givenAway = 0;
+    //the first card is set aside, then everyone is dealt one
+    knowledge->pos = 1 + knowledge->numPlayers;
+}
+
+/*
+ * yourturn: searches on every thread of the pool until the deadline,
+ * and plays the move visited most.
+ */
+static void ismcts_yourturn(void* state, char card, char move[3]) {
+    Ismcts* ismcts = state;
+    Knowledge* knowledge = &ismcts->knowledge;
+    uint64_t start = now_nanos();
+    char moves[MAX_MOVES][3];
+    Game game;
+
+    //the moves only hang on what everyone knows, so any deal will do
+    knowledge->given = card;
+    determinize(knowledge, &ismcts->workers[0].random, &game);
+    int numMoves = list_moves(&game, knowledge->seat, moves);
+    int best = 0;
+    if (numMoves > 1) {
+        ismcts->deadline = start + ismcts->budget * SEARCH_TENTHS / 10;
+        pthread_mutex_lock(&ismcts->lock);
+        ismcts->running = ismcts->numWorkers - 1;
+        ismcts->generation++;
+        pthread_cond_broadcast(&ismcts->wake);
+        pthread_mutex_unlock(&ismcts->lock);
+        search(&ismcts->workers[0]);
+        pthread_mutex_lock(&ismcts->lock);
+        while (ismcts->running > 0) {
+            pthread_cond_wait(&ismcts->done, &ismcts->lock);
+        }
+        pthread_mutex_unlock(&ismcts->lock);
+
+        //add up the visits of each first move over every tree
+        long visits[MAX_MOVES];
+        memset(visits, 0, sizeof(visits));
+        for (int i = 0; i < ismcts->numWorkers; i++) {
+            Node* nodes = ismcts->workers[i].nodes;
+            for (int c = nodes[0].child; c >= 0; c = nodes[c].sibling) {
+                for (int m = 0; m < numMoves; m++) {
+                    if (memcmp(moves[m], nodes[c].move, 3) == 0) {
+                        visits[m] += nodes[c].visits;
+                    }
+                }
+            }
+        }
+        for (int m = 1; m < numMoves; m++) {
+            if (visits[m] > visits[best]) {
+                best = m;
+            }
+        }
+    }
+    memcpy(move, moves[best], 3);
+    if (move[0] == knowledge->hand) {
+        knowledge->hand = card;
+    }
+    knowledge->given = 0;
+}
+
+/*
+ * Records that seat (not this one) played or dropped card from its hand:
+ * whatever it holds now could be anything, unless it still holds a card
+ * it is known to.
+ */
+static void lose_card(Knowledge* knowledge, int seat, char card) {
+    if (knowledge->known[seat] == card) {
+        knowledge->known[seat] = 0;
+    }
+    knowledge->possible[seat] = knowledge->known[seat] ?
+            CARD_BIT(knowledge->known[seat]) : ALL_CARDS;
+}
+
+/*
+ * thishappened: counts the cards shown, follows the deck position as the
+ * engine moves it, and learns what it can of who holds what.
+ */
+static void ismcts_thishappened(void* state, const Event* event) {
+    Knowledge* knowledge = &((Ismcts*)state)->knowledge;
+    int seat = knowledge->seat;
+    int mover = event->player - SHIFT;
+    int target = event->target == '-' ? -1 : event->target - SHIFT;
+    //the seat other than this one in a move between this one and another
+    int other = mover == seat ? target : mover;
+
+    knowledge->pos++; //the mover was dealt a card
+    knowledge->played[event->card - '0']++;
+    knowledge->protected[mover] = event->card == '4';
+    if (mover != seat) {
+        lose_card(knowledge, mover, event->card);
+    }
+    if (event->dropped >= '1' && event->dropped <= '8') {
+        knowledge->played[event->dropped - '0']++;
+    }
+    if (target >= 0 && target != mover) {
+        switch (event->card) {
+            case '1':
+                if (event->eliminated != '-') {
+                    knowledge->shown[target] = true;
+                } else if (event->guess >= '2' && event->guess <= '8') {
+                    knowledge->possible[target] &= ~CARD_BIT(event->guess);
+                }
+                break;
+            case '3':
+                //nobody out means the two hold the same card
+                if (event->eliminated == '-' && (mover == seat ||
+                        target == seat)) {
+                    knowledge->known[other] = knowledge->hand;
+                    knowledge->possible[other] = CARD_BIT(knowledge->hand);
+                } else if (event->eliminated == '-') {
+                    knowledge->possible[mover] &= knowledge->possible[target];
+                    knowledge->possible[target] = knowledge->possible[mover];
+                }
+                break;
+            case '6':
+                if (mover == seat || target == seat) {
+                    knowledge->known[other] = knowledge->givenAway;
+                    knowledge->possible[other] =
+                            CARD_BIT(knowledge->givenAway);
+                } else {
+                    int possible = knowledge->possible[mover];
+                    char known = knowledge->known[mover];
+                    knowledge->possible[mover] = knowledge->possible[target];
+                    knowledge->known[mover] = knowledge->known[target];
+                    knowledge->possible[target] = possible;
+                    knowledge->known[target] = known;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (event->card == '5') {
+        //the target is dealt a card, and drops it back on the deck if
+        //they were put out by dropping an 8
+        if (knowledge->pos < DECK_SIZE) {
+            knowledge->pos++;
+        }
+        if (event->dropped == '8') {
+            knowledge->pos--;
+            knowledge->shown[target] = true;
+        }
+        if (target != seat) {
+            knowledge->known[target] = 0;
+            knowledge->possible[target] = ALL_CARDS;
+        }
+    }
+    if (event->eliminated != '-') {
+        knowledge->out[event->eliminated - SHIFT] = true;
+    }
+}
+
+/*
+ * replace: the card held is replaced with card.
+ */
+static void ismcts_replace(void* state, char card) {
+    Knowledge* knowledge = &((Ismcts*)state)->knowledge;
+
+    knowledge->givenAway = knowledge->hand;
+    knowledge->hand = card;
+}
+
+/*
+ * scores: nothing to do.
+ */
+static void ismcts_scores(void* state, const int* scores, int numPlayers) {
+}
+
+/* The ismcts strategy */
+const Strategy ismctsStrategy = {
+    ismcts_create,
+    ismcts_destroy,
+    ismcts_newround,
+    ismcts_yourturn,
+    ismcts_thishappened,
+    ismcts_replace,
+    ismcts_scores
+};
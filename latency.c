@@ -0,0 +1,98 @@
+/*
+ * Latency histograms (libloveletter)
+ */
+
+#include <time.h>
+#include "latency.h"
+
+/* Half the sub-buckets: the ones each power of 2 above the first gets */
+#define HALF_BUCKETS (LATENCY_SUB_BUCKETS / 2)
+/* log2 of HALF_BUCKETS, the shift of the first power of 2 split up */
+#define HALF_SHIFT 5
+
+/*
+ * Returns the time on the monotonic clock, in nanoseconds.
+ */
+uint64_t now_nanos(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * Returns the bucket nanos falls in. Above the first LATENCY_SUB_BUCKETS
+ * values, the bucket is the value's top 6 bits, after the buckets of the
+ * powers of 2 below it.
+ */
+static int bucket_of(uint64_t nanos) {
+    if (nanos < LATENCY_SUB_BUCKETS) {
+        return nanos;
+    }
+    int shift = 63 - __builtin_clzll(nanos) - HALF_SHIFT;
+    return (shift << HALF_SHIFT) + (nanos >> shift);
+}
+
+/*
+ * Returns the largest value that falls in bucket.
+ */
+static uint64_t bucket_top(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / HALF_BUCKETS - 1;
+    uint64_t sub = bucket - (shift << HALF_SHIFT);
+    return ((sub + 1) << shift) - 1;
+}
+
+/*
+ * Adds a time of nanos to histogram.
+ */
+void record_latency(Histogram* histogram, uint64_t nanos) {
+    histogram->buckets[bucket_of(nanos)]++;
+    histogram->count++;
+    histogram->total += nanos;
+    if (nanos > histogram->max) {
+        histogram->max = nanos;
+    }
+}
+
+/*
+ * Returns the time percentile percent of the times in histogram are no
+ * longer than (to within its bucket, but never more than the maximum),
+ * or 0 if it is empty.
+ */
+uint64_t latency_percentile(const Histogram* histogram, double percentile) {
+    //the number of times at or below the percentile, rounded up
+    double exact = histogram->count * percentile / 100.0;
+    uint64_t wanted = exact;
+    uint64_t seen = 0;
+
+    if (wanted < exact || wanted < 1) {
+        wanted++;
+    }
+    for (int b = 0; b < LATENCY_BUCKETS && histogram->count > 0; b++) {
+        seen += histogram->buckets[b];
+        if (seen >= wanted) {
+            uint64_t top = bucket_top(b);
+            return top < histogram->max ? top : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/*
+ * Writes the stats file line of histogram, the times of phase for seat,
+ * to out.
+ */
+void write_latency(FILE* out, const char* phase, char seat,
+        const Histogram* histogram) {
+    fprintf(out, "%s %c %llu %llu %llu %llu %llu %llu\n", phase, seat,
+            (unsigned long long)histogram->count,
+            (unsigned long long)(histogram->count > 0 ?
+            histogram->total / histogram->count : 0),
+            (unsigned long long)latency_percentile(histogram, 50),
+            (unsigned long long)latency_percentile(histogram, 99),
+            (unsigned long long)latency_percentile(histogram, 99.9),
+            (unsigned long long)histogram->max);
+}
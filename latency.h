@@ -0,0 +1,49 @@
+/*
+ * Latency histograms (libloveletter)
+ *
+ * Times are kept in nanoseconds in log-linear buckets, as HDR histograms
+ * do: values under LATENCY_SUB_BUCKETS get a bucket each, and every
+ * power of 2 above that is split into LATENCY_SUB_BUCKETS / 2 buckets,
+ * so any value is known to within 1/32 of itself whatever its size,
+ * in constant memory.
+ *
+ * In a stats file, a histogram is one line under a LATENCY_COLUMNS
+ * header: the phase timed, the seat (or - for none in particular), the
+ * number of times, then the mean, 50th, 99th and 99.9th percentiles and
+ * the maximum, all in nanoseconds. Fields are separated by single
+ * spaces.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Buckets per power of 2 (twice over, below the first) */
+#define LATENCY_SUB_BUCKETS 64
+/* Enough buckets for any 64 bit value */
+#define LATENCY_BUCKETS 1920
+/* The header line of a stats file */
+#define LATENCY_COLUMNS "phase seat count mean p50 p99 p999 max"
+
+/* A histogram of times
+ * - count: the number of times recorded
+ * - total: the sum of the times
+ * - max: the longest time
+ * - buckets: how many times fell in each bucket
+ */
+typedef struct Histogram {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[LATENCY_BUCKETS];
+} Histogram;
+
+uint64_t now_nanos(void);
+void record_latency(Histogram* histogram, uint64_t nanos);
+uint64_t latency_percentile(const Histogram* histogram, double percentile);
+void write_latency(FILE* out, const char* phase, char seat,
+        const Histogram* histogram);
+
+#endif
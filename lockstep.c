@@ -0,0 +1,367 @@
+/*
+ * Lockstep batch simulation (libloveletter)
+ *
+ * simulate_lockstep plays the basic strategy against itself, LANES games
+ * at a time. The games are kept as a structure of arrays: every field is
+ * a vector holding that field of each game in a byte lane, so a turn of
+ * every game is taken by the same short run of vector operations. Nothing
+ * branches on a game's state; each card's effect is worked out in every
+ * lane and only kept where a mask says it applies. Starting and scoring
+ * rounds, which comes far less often, is done a game at a time.
+ *
+ * The basic strategy only acts on its own cards and on what every player
+ * has been told, which the engine knows as well, so the games need no
+ * strategy state and go exactly as simulate_batch would play them.
+ *
+ * Built with LOCKSTEP_AVX2 (and -mavx2), this file is only the engine,
+ * as simulate_lockstep_avx2, with twice the lanes. Built with
+ * LOCKSTEP_DISPATCH, simulate_lockstep hands games to that one on CPUs
+ * that have AVX2.
+ */
+
+#include <string.h>
+#include "loveletter.h"
+
+/* Games played at once: a byte each of a vector register */
+#ifdef __AVX2__
+#define LANES 32
+#else
+#define LANES 16
+#endif
+/* The target of a move that aims at nobody */
+#define NO_SEAT 0xff
+/* Turns a vector comparison into a mask of the same type as its lanes */
+#define MASK(comparison) ((Lanes)(comparison))
+
+/* One byte per game */
+typedef uint8_t Lanes __attribute__((vector_size(LANES)));
+
+/* The games being played at once. Cards are numbers (1 to 8) and seats
+ * are indices; masks have every bit of a lane set where they hold.
+ * - deck: card k of each game's deck for the round
+ * - pos: the next card of each deck
+ * - turn: the seat to look at first for the next turn
+ * - holding: each seat's card
+ * - out: each seat's mask of being out of the round
+ * - protected: each seat's mask of being protected
+ * - played: how many of each card everyone has seen played this round
+ * - roundTurns: the turns taken this round
+ * - live: the mask of lanes with a game in them
+ * - roundOver: the mask of games whose round just ended
+ * - numPlayers: the number of players in every game
+ * - scores: each game's scores
+ * - deckIndex: the index in the corpus of each game's deck
+ */
+typedef struct Lockstep {
+    Lanes deck[DECK_SIZE];
+    Lanes pos;
+    Lanes turn;
+    Lanes holding[MAX_PLAYERS];
+    Lanes out[MAX_PLAYERS];
+    Lanes protected[MAX_PLAYERS];
+    Lanes played[9];
+    Lanes roundTurns;
+    Lanes live;
+    Lanes roundOver;
+    int numPlayers;
+    int scores[LANES][MAX_PLAYERS];
+    long deckIndex[LANES];
+} Lockstep;
+
+/*
+ * Returns a vector with value in every lane.
+ */
+static inline Lanes splat(int value) {
+    return (Lanes){0} + (uint8_t)value;
+}
+
+/*
+ * Returns a in the lanes where mask is set, and b in the rest.
+ */
+static inline Lanes blend(Lanes mask, Lanes a, Lanes b) {
+    return (a & mask) | (b & ~mask);
+}
+
+/*
+ * Returns fields[index] in each lane, for that lane's index (0 where
+ * index is count or more).
+ */
+static inline Lanes pick(const Lanes* fields, Lanes index, int count) {
+    Lanes value = {0};
+
+    for (int i = 0; i < count; i++) {
+        value |= fields[i] & MASK(index == splat(i));
+    }
+    return value;
+}
+
+/*
+ * Takes a turn in every live game: deals the next player a card, makes
+ * the basic strategy's move for them and applies it. Marks the games
+ * whose round it ended in roundOver.
+ */
+static void take_turns(Lockstep* games) {
+    int n = games->numPlayers;
+    Lanes live = games->live;
+    Lanes one = splat(1);
+
+    //the first seat from turn on that is still in the round
+    Lanes me = games->turn;
+    for (int i = 0; i < n; i++) {
+        me &= ~MASK(me >= splat(n));
+        me += pick(games->out, me, n) & one;
+    }
+    Lanes given = pick(games->deck, games->pos, DECK_SIZE);
+    games->pos += live & one;
+
+    //discard a 7 kept with a 5 or 6, and otherwise the lower card
+    Lanes first = pick(games->holding, me, n);
+    Lanes sevenFirst = MASK(first == 7) &
+            (MASK(given == 5) | MASK(given == 6));
+    Lanes sevenGiven = MASK(given == 7) &
+            (MASK(first == 5) | MASK(first == 6));
+    Lanes playFirst = sevenFirst | (~sevenGiven & MASK(first < given));
+    Lanes card = blend(playFirst, first, given);
+    Lanes kept = blend(playFirst, given, first);
+
+    //aim at the first seat after the player that is in and unprotected
+    Lanes target = splat(NO_SEAT);
+    Lanes found = {0};
+    for (int k = 1; k < n; k++) {
+        Lanes seat = me + splat(k);
+        seat -= MASK(seat >= splat(n)) & splat(n);
+        Lanes open = ~pick(games->protected, seat, n) &
+                ~pick(games->out, seat, n) & ~found;
+        target = blend(open, seat, target);
+        found |= open;
+    }
+    //a 5 with nobody else to aim at is aimed at the player
+    Lanes five = MASK(card == 5);
+    target = blend(five & ~found, me, target);
+    Lanes aimed = live & (five | (found & (MASK(card == 1) |
+            MASK(card == 3) | MASK(card == 6))));
+    //guess the highest card (bar 1) not all seen played
+    Lanes guess = {0};
+    for (int v = 2; v <= 8; v++) {
+        guess = blend(MASK(games->played[v] < splat(cardCopies[v])), splat(v),
+                guess);
+    }
+
+    //the player keeps the other card, and their protection is over
+    for (int p = 0; p < n; p++) {
+        Lanes isMe = live & MASK(me == splat(p));
+        games->holding[p] = blend(isMe, kept, games->holding[p]);
+        games->out[p] |= isMe & MASK(card == 8);
+        games->protected[p] = blend(isMe, MASK(card == 4),
+                games->protected[p]);
+    }
+    Lanes theirs = pick(games->holding, target, n);
+    Lanes swaps = aimed & MASK(card == 6);
+    Lanes replaces = aimed & five;
+    Lanes compares = aimed & MASK(card == 3);
+    Lanes hits = aimed & MASK(card == 1) & MASK(theirs == guess);
+    //a 5 deals the target a new card, or the one set aside if none left
+    Lanes left = MASK(games->pos < DECK_SIZE);
+    Lanes dealt = blend(left, pick(games->deck, games->pos, DECK_SIZE),
+            games->deck[0]);
+    Lanes droppedEight = replaces & MASK(theirs == 8);
+    games->pos += replaces & left & one;
+    games->pos -= droppedEight & one;
+    //a 3 puts out whoever holds the lower card
+    Lanes meLower = compares & MASK(kept < theirs);
+    Lanes targetLower = compares & MASK(theirs < kept);
+    for (int p = 0; p < n; p++) {
+        Lanes isMe = MASK(me == splat(p));
+        Lanes isTarget = MASK(target == splat(p));
+        games->holding[p] = blend(isTarget & swaps, kept,
+                blend(isMe & swaps, theirs, games->holding[p]));
+        games->holding[p] = blend(isTarget & replaces, dealt,
+                games->holding[p]);
+        games->out[p] |= (isTarget & (droppedEight | targetLower | hits)) |
+                (isMe & meLower);
+    }
+    //everyone sees the card played, a card a 5 made them drop, and a
+    //card a 1 guessed right
+    for (int v = 1; v <= 8; v++) {
+        games->played[v] += live & MASK(card == splat(v)) & one;
+        games->played[v] += replaces & MASK(theirs == splat(v)) & one;
+        games->played[v] += hits & MASK(guess == splat(v)) & one;
+    }
+
+    games->turn = blend(live, me + 1, games->turn);
+    games->roundTurns += live & one;
+    Lanes numOut = {0};
+    for (int p = 0; p < n; p++) {
+        numOut += games->out[p] & one;
+    }
+    games->roundOver = live & (MASK(games->pos == DECK_SIZE) |
+            MASK(numOut == splat(n - 1)));
+}
+
+/*
+ * Starts a round in lane with the lane's deck of corpus. Returns false if
+ * the corpus has no deck for it.
+ */
+static bool start_lane(Lockstep* games, int lane, const DeckCorpus* corpus) {
+    Deck deck;
+
+    if (!get_deck(corpus, games->deckIndex[lane], &deck)) {
+        return false;
+    }
+    for (int k = 0; k < DECK_SIZE; k++) {
+        games->deck[k][lane] = deck.cards[k] - '0';
+    }
+    //the first card is set aside, then everyone is dealt one
+    for (int p = 0; p < games->numPlayers; p++) {
+        games->holding[p][lane] = deck.cards[1 + p] - '0';
+        games->out[p][lane] = 0;
+        games->protected[p][lane] = 0;
+    }
+    for (int v = 0; v <= 8; v++) {
+        games->played[v][lane] = 0;
+    }
+    games->pos[lane] = 1 + games->numPlayers;
+    games->turn[lane] = 0;
+    games->roundTurns[lane] = 0;
+    games->roundOver[lane] = 0;
+    return true;
+}
+
+/*
+ * Scores the round that just ended in lane, as the engine does: everyone
+ * still in holding the highest card still held wins a point. Adds it to
+ * stats, and moves the game on to its next deck. Returns true if the game
+ * is over, which is added to stats too.
+ */
+static bool finish_lane(Lockstep* games, int lane, const DeckCorpus* corpus,
+        BatchStats* stats) {
+    int n = games->numPlayers;
+    int* scores = games->scores[lane];
+    int high = 1;
+    bool over = false;
+
+    for (int p = 0; p < n; p++) {
+        if (!games->out[p][lane] && games->holding[p][lane] >= high) {
+            high = games->holding[p][lane];
+        }
+    }
+    for (int p = 0; p < n; p++) {
+        if (!games->out[p][lane] && games->holding[p][lane] == high) {
+            scores[p]++;
+        }
+        over = over || scores[p] >= WINNING_SCORE;
+    }
+    stats->rounds++;
+    stats->turns += games->roundTurns[lane];
+    if (++games->deckIndex[lane] == corpus->numDecks) {
+        games->deckIndex[lane] = 0;
+    }
+    if (over) {
+        stats->games++;
+        for (int p = 0; p < n; p++) {
+            stats->points[p] += scores[p];
+            if (scores[p] == WINNING_SCORE) {
+                stats->wins[p]++;
+            }
+        }
+    }
+    return over;
+}
+
+/*
+ * Puts game number game (if there are numGames or fewer) in lane, which
+ * starts on deck firstDeck + game. Returns false if the corpus has no
+ * deck for it.
+ */
+static bool fill_lane(Lockstep* games, int lane, long game, long numGames,
+        const DeckCorpus* corpus, long firstDeck) {
+    if (game >= numGames) {
+        games->live[lane] = 0;
+        games->roundOver[lane] = 0;
+        return true;
+    }
+    games->live[lane] = 0xff;
+    memset(games->scores[lane], 0, sizeof(games->scores[lane]));
+    games->deckIndex[lane] = (firstDeck + game) % corpus->numDecks;
+    return start_lane(games, lane, corpus);
+}
+
+/*
+ * Returns true if any lane of mask is set.
+ */
+static bool any_lane(Lanes mask) {
+    uint64_t words[LANES / 8];
+
+    memcpy(words, &mask, LANES);
+    for (int i = 1; i < LANES / 8; i++) {
+        words[0] |= words[i];
+    }
+    return words[0] != 0;
+}
+
+/*
+ * Plays numGames games as simulate_lockstep does, LANES at a time.
+ */
+static int play_lockstep(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, BatchStats* stats) {
+    Lockstep games;
+    long nextGame = 0;
+
+    memset(&games, 0, sizeof(Lockstep));
+    games.numPlayers = numPlayers;
+    for (int lane = 0; lane < LANES; lane++) {
+        if (!fill_lane(&games, lane, nextGame++, numGames, corpus,
+                firstDeck)) {
+            return MOVE_NO_DECK;
+        }
+    }
+    while (any_lane(games.live)) {
+        take_turns(&games);
+        if (!any_lane(games.roundOver)) {
+            continue;
+        }
+        for (int lane = 0; lane < LANES; lane++) {
+            if (!games.roundOver[lane]) {
+                continue;
+            }
+            bool started = finish_lane(&games, lane, corpus, stats) ?
+                    fill_lane(&games, lane, nextGame++, numGames, corpus,
+                    firstDeck) : start_lane(&games, lane, corpus);
+            if (!started) {
+                return MOVE_NO_DECK;
+            }
+        }
+    }
+    return MOVE_OK;
+}
+
+#ifdef LOCKSTEP_AVX2
+/*
+ * simulate_lockstep, for CPUs with AVX2.
+ */
+int simulate_lockstep_avx2(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, BatchStats* stats) {
+    return play_lockstep(corpus, firstDeck, numPlayers, numGames, stats);
+}
+#else
+int simulate_lockstep_avx2(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, BatchStats* stats);
+
+/*
+ * Plays numGames games of numPlayers players between copies of the basic
+ * strategy, many at a time. Game g starts on deck firstDeck + g of
+ * corpus and takes the decks after it in turn, so the totals added to
+ * stats are the same as simulate_batch gives a game at a time with each
+ * seat basic. Returns MOVE_OK, or MOVE_NO_DECK if the decks ran out.
+ */
+int simulate_lockstep(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, BatchStats* stats) {
+#ifdef LOCKSTEP_DISPATCH
+    if (__builtin_cpu_supports("avx2")) {
+        return simulate_lockstep_avx2(corpus, firstDeck, numPlayers,
+                numGames, stats);
+    }
+#endif
+    return play_lockstep(corpus, firstDeck, numPlayers, numGames, stats);
+}
+#endif
@@ -0,0 +1,693 @@
+/*
+ * The Love Letter rules engine (libloveletter)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dlfcn.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "loveletter.h"
+
+/* The histogram of a deck: 5 x '1', 2 x '2' to '5' and 1 x '6' to '8',
+ * with 4 bits per card */
+#define FULL_DECK 0x11122225
+
+/*
+ * Checks the sum and type of chars in the input array - corresponding to
+ * a line in a deck file. The sum of all chars in the array must be 54.
+ * There must be 5 x '1', 2 x '2', 2 x '3', 2 x '4', 2 x '5', 1 x '6',
+ * 1 x '7' and 1 x '8'.
+ * Returns true if input contains exactly those chars (as listed above).
+ *
+ * The count of each card is kept in its own 4 bits of one histogram,
+ * card '1' lowest. Only the right deck of 16 cards adds up to
+ * FULL_DECK: with no card allowed 16 times, a count can only carry into
+ * the next card's bits by having more than 16 cards.
+ */
+bool check_sum(const char input[DECK_SIZE]) {
+    uint32_t histogram = 0;
+
+#ifdef __SSE2__
+    //one compare of all 16 cards per card value
+    __m128i cards = _mm_loadu_si128((const __m128i*)input);
+    for (int c = 0; c < 8; c++) {
+        int matches = _mm_movemask_epi8(_mm_cmpeq_epi8(cards,
+                _mm_set1_epi8('1' + c)));
+        histogram += __builtin_popcount(matches) << (4 * c);
+    }
+#else
+    for (int i = 0; i < DECK_SIZE; i++) {
+        //anything that is not a card spoils the histogram
+        if (input[i] < '1' || input[i] > '8') {
+            return false;
+        }
+        histogram += 1 << (4 * (input[i] - '1'));
+    }
+#endif
+    return histogram == FULL_DECK;
+}
+
+/*
+ * Sets up game for a new game of numPlayers players whose first round
+ * is played with deck deckIndex of corpus.
+ */
+void init_game(Game* game, int numPlayers, const DeckCorpus* corpus,
+        long deckIndex) {
+    memset(game, 0, sizeof(Game));
+    game->numPlayers = numPlayers;
+    game->corpus = corpus;
+    game->deckIndex = deckIndex;
+    game->given = '-';
+    for (int i = 0; i < numPlayers; i++) {
+        game->players[i].label = i + SHIFT; //shift for ascii
+        game->players[i].holding = '-';
+    }
+}
+
+/*
+ * Returns the next card in the current deck, or '-' if the last card in
+ * the deck has been reached.
+ */
+static char get_next_card(Game* game) {
+    if (game->pos < DECK_SIZE) {
+        return game->deck.cards[game->pos++];
+    } else {
+        return '-';
+    }
+}
+
+/*
+ * Starts a new round with the round's deck: nobody is out or protected
+ * and each player is dealt one card, in seat order, which is left in
+ * their holding. The deck is only got now, so a stream is never read
+ * further than the rounds played. Returns false if the corpus has no
+ * deck left for the round.
+ */
+bool start_round(Game* game) {
+    if (!get_deck(game->corpus, game->deckIndex, &game->deck)) {
+        return false;
+    }
+    game->pos = 1; //the first card is always set aside
+    for (int i = 0; i < game->numPlayers; i++) {
+        game->players[i].outOfRound = false; //no one is out
+        game->players[i].protected = false; //no one is protected
+        game->players[i].holding = get_next_card(game);
+    }
+    game->turn = 0;
+    game->given = '-';
+    game->roundOver = check_end_of_round(game);
+    return true;
+}
+
+/*
+ * Checks if end of round conditions are met. Conditions: all players bar
+ * one are eliminated or there are no cards left in the deck.
+ */
+bool check_end_of_round(const Game* game) {
+    //An int to record the number of players that are out
+    int numOut = 0;
+
+    //Loop through and check the number that are out
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i].outOfRound) {
+            numOut++;
+        }
+    }
+    //if it's 16 then we finished the Deck, and the round is over
+    if (game->pos == DECK_SIZE) {
+        return true;
+    } else if (numOut == (game->numPlayers - 1)) {
+        //If all bar one players are out, then the round is over
+        return true;
+    } else {
+        return false;
+    }
+}
+
+/*
+ * Checks if there are unprotected players who are still playing the game
+ * and who are not the player.
+ * Returns true if there are, false otherwise.
+ */
+bool target_available(const Game* game, int player) {
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i].protected == false &&
+                game->players[i].outOfRound == false && i != player) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns a boolean to indicate if there is a winner.
+ * A winner is indicated by a player with a score == 4.
+ */
+bool is_winner(const Game* game) {
+    //check for >= 4 in case of error
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->scores[i] >= WINNING_SCORE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Deals the next turn of the round: finds the next player still in the
+ * round, in seat order, and gives them the next card in the deck.
+ * Returns that player, or -1 if the round is over (which includes
+ * running out of cards before anyone can be dealt).
+ */
+int next_turn(Game* game) {
+    if (game->roundOver) {
+        return -1;
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->turn >= game->numPlayers) {
+            game->turn = 0;
+        }
+        if (!game->players[game->turn].outOfRound) {
+            break;
+        }
+        game->turn++;
+    }
+    //get next card and check if '-' (means end of deck)
+    if ((game->given = get_next_card(game)) == '-') {
+        game->roundOver = true;
+        return -1;
+    }
+    return game->turn;
+}
+
+/*
+ * Sets the scores for each player according to the cards they are
+ * holding and whether they are out of the round
+ */
+static void set_scores(Game* game) {
+    /*Initialise the highCard to 1*/
+    char highCard = '1';
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        //get the highcard
+        if (game->players[i].holding >= highCard &&
+                game->players[i].outOfRound == false) {
+            highCard = game->players[i].holding;
+        }
+    }
+    //Check if they are not holding the highCard
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->players[i].holding != highCard) {
+            game->players[i].outOfRound = true;
+        }
+    }
+    //All who are still in get 1 added to their score
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (!(game->players[i].outOfRound)) {
+            game->scores[i] += 1;
+        }
+    }
+}
+
+/*
+ * Fills in the thishappened for outcome.
+ */
+static void set_event(Outcome* outcome, char player, char card,
+        char targetPlayer, char guessCard, char dropper, char dropped,
+        char eliminated) {
+    outcome->event.player = player;
+    outcome->event.card = card;
+    outcome->event.target = targetPlayer;
+    outcome->event.guess = guessCard;
+    outcome->event.dropper = dropper;
+    outcome->event.dropped = dropped;
+    outcome->event.eliminated = eliminated;
+}
+
+/*
+ * Records that seat is to be sent a replace with card.
+ */
+static void add_replace(Outcome* outcome, int seat, char card) {
+    outcome->replacedSeat[outcome->numReplaced] = seat;
+    outcome->replacedCard[outcome->numReplaced] = card;
+    outcome->numReplaced++;
+}
+
+/*
+ * Checks the card specific rules for playedCard, where holding is the
+ * card the player keeps. Returns true if the move is allowed.
+ */
+static bool check_move(const Game* game, int player, char targetPlayer,
+        char holding, char playedCard, char guess) {
+    bool noTarget = targetPlayer == '-';
+
+    switch (playedCard) {
+        case '8':
+        case '7':
+        case '4':
+        case '2':
+            return true;
+        case '6': //can't discard 6 in preference to 7
+            return holding != '7' && guess == '-' &&
+                    !(noTarget && target_available(game, player));
+        case '5': //can't discard 5 in preference to 7, must target
+            return holding != '7' && guess == '-' && !noTarget;
+        case '3':
+            return guess == '-' &&
+                    !(noTarget && target_available(game, player));
+        case '1': //guess cannot be 1, or be made without a target
+            return guess != '1' && !(noTarget && guess != '-') &&
+                    !(noTarget && target_available(game, player));
+        default: //not a valid card
+            return false;
+    }
+}
+
+/*
+ * Perform a swap between a player and a targetPlayer. Triggered by a 6.
+ */
+static void swap(Game* game, int player, char targetPlayer,
+        Outcome* outcome) {
+    //Check targetPlayer is a player
+    if (targetPlayer != '-') {
+        int target = targetPlayer - SHIFT;
+        //send whatever the player was holding to target, and what the
+        //target was holding to player
+        add_replace(outcome, target, game->players[player].holding);
+        add_replace(outcome, player, game->players[target].holding);
+
+        //update state
+        char c = game->players[target].holding;
+        game->players[target].holding = game->players[player].holding;
+        game->players[player].holding = c;
+    }
+    set_event(outcome, player + SHIFT, '6', targetPlayer, '-', '-', '-',
+            '-');
+}
+
+/*
+ * Triggered by card 5, target discards and gets new card from deck (or
+ * the card set aside if the deck is empty).
+ */
+static void new_card(Game* game, int player, char targetPlayer,
+        Outcome* outcome) {
+    int target = targetPlayer - SHIFT;
+    //Get the next deckCard (note: it incremements the pos count)
+    char deckCard = get_next_card(game);
+
+    // if '-', wrap around the the first card
+    if (deckCard == '-') {
+        deckCard = game->deck.cards[0];
+    }
+    add_replace(outcome, target, deckCard);
+
+    //get card they are holding before it changes
+    char oldCard = game->players[target].holding;
+    game->players[target].holding = deckCard;
+
+    //check oldCard was 8 (they are outOfRound)
+    if (oldCard == '8') {
+        //They discarded an 8, so are out and do not get a card
+        game->players[target].outOfRound = true;
+        game->pos--; //we just incremented the position
+        set_event(outcome, player + SHIFT, '5', targetPlayer, '-',
+                targetPlayer, oldCard, targetPlayer);
+    } else {
+        set_event(outcome, player + SHIFT, '5', targetPlayer, '-',
+                targetPlayer, oldCard, '-');
+    }
+}
+
+/*
+ * Compare between a player and a targetPlayer, triggered by a 3. The
+ * player holding the lower card is out. The thishappened names the loser
+ * as dropper but, as it always has, leaves the dropped card as '-'; the
+ * loser's card is still in their holding.
+ */
+static void compare(Game* game, int player, char targetPlayer,
+        Outcome* outcome) {
+    /*The loser of the comparison*/
+    char loser = '-';
+
+    if (targetPlayer != '-') {
+        //The cards to compareTo and compareFrom
+        char compareFrom = game->players[player].holding;
+        char compareTo = game->players[targetPlayer - SHIFT].holding;
+
+        if (compareTo > compareFrom) {
+            loser = player + SHIFT;
+        } else if (compareFrom > compareTo) {
+            loser = targetPlayer;
+        }
+        if (loser != '-') {
+            game->players[loser - SHIFT].outOfRound = true;
+        }
+    }
+    set_event(outcome, player + SHIFT, '3', targetPlayer, '-', loser, '-',
+            loser);
+}
+
+/*
+ * Performs a guess move, triggered by a 1. The target is out if they are
+ * holding the guessed card.
+ */
+static void guess_card(Game* game, int player, char targetPlayer,
+        char guess, Outcome* outcome) {
+    if (targetPlayer != '-' &&
+            game->players[targetPlayer - SHIFT].holding == guess) {
+        game->players[targetPlayer - SHIFT].outOfRound = true;
+        set_event(outcome, player + SHIFT, '1', targetPlayer, guess,
+                targetPlayer, guess, targetPlayer);
+    } else {
+        set_event(outcome, player + SHIFT, '1', targetPlayer, guess, '-',
+                '-', '-');
+    }
+}
+
+/*
+ * Dispatches the move indicated by the playedCard to the appropriate
+ * sub function. Cards without a target report no target.
+ */
+static void dispatch_move(Game* game, int player, char targetPlayer,
+        char playedCard, char guess, Outcome* outcome) {
+    switch (playedCard) {
+        case '8': //player is out
+            game->players[player].outOfRound = true;
+            set_event(outcome, player + SHIFT, playedCard, '-', '-', '-',
+                    '-', player + SHIFT);
+            break;
+        case '6': //swap cards with target
+            swap(game, player, targetPlayer, outcome);
+            break;
+        case '5': //targeted player gets new card
+            new_card(game, player, targetPlayer, outcome);
+            break;
+        case '4': //player is immune
+            game->players[player].protected = true;
+            set_event(outcome, player + SHIFT, playedCard, '-', '-', '-',
+                    '-', '-');
+            break;
+        case '3':
+            compare(game, player, targetPlayer, outcome);
+            break;
+        case '1':
+            guess_card(game, player, targetPlayer, guess, outcome);
+            break;
+        default: //2 and 7 have no effect
+            set_event(outcome, player + SHIFT, playedCard, '-', '-', '-',
+                    '-', '-');
+            break;
+    }
+}
+
+/*
+ * Applies the move (of the form c1pc2) made by player in reply to the
+ * card dealt by next_turn. Updates the player's holding, applies the
+ * card's effect and fills in outcome. Ends the round and scores it if
+ * the move finished the round.
+ * Returns MOVE_OK, or MOVE_INVALID (leaving game untouched) if the move
+ * breaks the rules.
+ */
+int apply_move(Game* game, int player, const char move[3],
+        Outcome* outcome) {
+    char playedCard = move[0];
+    char targetPlayer = move[1];
+    char guess = move[2];
+    char holding = game->players[player].holding;
+
+    //check they are holding the card they played, they keep the other
+    if (holding != playedCard && game->given != playedCard) {
+        return MOVE_INVALID;
+    }
+    if (holding == playedCard) {
+        holding = game->given;
+    }
+
+    //check the bounds of targetPlayer and guess
+    if (targetPlayer != '-' && (targetPlayer < 'A' || targetPlayer >=
+            (game->numPlayers + SHIFT))) {
+        return MOVE_INVALID;
+    }
+    if ((guess != '-' && (guess > '9' || guess < '0')) ||
+            ((player + SHIFT) == targetPlayer && playedCard != '5')) {
+        return MOVE_INVALID;
+    }
+    //can't target a protected player (their own protection is over)
+    if (targetPlayer != '-' && (player + SHIFT) != targetPlayer &&
+            game->players[targetPlayer - SHIFT].protected) {
+        return MOVE_INVALID;
+    }
+    if (!check_move(game, player, targetPlayer, holding, playedCard,
+            guess)) {
+        return MOVE_INVALID;
+    }
+
+    //the move is valid, update the state
+    game->players[player].holding = holding;
+    game->players[player].protected = false;
+    outcome->numReplaced = 0;
+    dispatch_move(game, player, targetPlayer, playedCard, guess, outcome);
+    game->given = '-';
+    game->turn = player + 1;
+
+    //check for outOfRound
+    game->roundOver = check_end_of_round(game);
+    if (game->roundOver) {
+        set_scores(game);
+    }
+    return MOVE_OK;
+}
+
+/*
+ * Moves on to the next deck once a round is over.
+ */
+void finish_round(Game* game) {
+    if (++game->deckIndex == game->corpus->numDecks) {
+        game->deckIndex = 0;
+    }
+    game->round++;
+}
+
+/*
+ * Sends outcome to each strategy in a batch game, as the hub would send
+ * replace and thishappened messages.
+ */
+static void notify_outcome(const Game* game, const Strategy* seats[],
+        void* states[], const Outcome* outcome) {
+    for (int i = 0; i < outcome->numReplaced; i++) {
+        int seat = outcome->replacedSeat[i];
+        seats[seat]->on_replace(states[seat], outcome->replacedCard[i]);
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        seats[i]->on_thishappened(states[i], &outcome->event);
+    }
+}
+
+/*
+ * Plays the next round of game between the strategies in seats, adding
+ * its turns to stats. Returns MOVE_OK, MOVE_INVALID if a strategy made
+ * an invalid move or MOVE_NO_DECK if the decks ran out.
+ */
+static int play_batch_round(Game* game, const Strategy* seats[],
+        void* states[], BatchStats* stats) {
+    Outcome outcome;
+    char move[3];
+    int player;
+
+    if (!start_round(game)) {
+        return MOVE_NO_DECK;
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        seats[i]->on_newround(states[i], game->players[i].holding);
+    }
+    while ((player = next_turn(game)) >= 0) {
+        seats[player]->on_yourturn(states[player], game->given, move);
+        if (apply_move(game, player, move, &outcome) != MOVE_OK) {
+            return MOVE_INVALID;
+        }
+        notify_outcome(game, seats, states, &outcome);
+        stats->turns++;
+    }
+    finish_round(game);
+    for (int i = 0; i < game->numPlayers; i++) {
+        seats[i]->on_scores(states[i], game->scores, game->numPlayers);
+    }
+    stats->rounds++;
+    return MOVE_OK;
+}
+
+/*
+ * Plays one game in game (already initialised) between the strategies
+ * in seats, adding to stats. Returns MOVE_OK, MOVE_INVALID if a
+ * strategy made an invalid move or MOVE_NO_DECK if the decks ran out.
+ */
+static int play_batch_game(Game* game, const Strategy* seats[],
+        void* states[], BatchStats* stats) {
+    while (!is_winner(game)) {
+        int result = play_batch_round(game, seats, states, stats);
+        if (result != MOVE_OK) {
+            return result;
+        }
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        stats->points[i] += game->scores[i];
+        if (game->scores[i] == WINNING_SCORE) {
+            stats->wins[i]++;
+        }
+    }
+    stats->games++;
+    return MOVE_OK;
+}
+
+/*
+ * Plays numGames games of numPlayers players in this process, each seat
+ * played by the matching strategy in seats. Games take decks in turn
+ * from corpus, the first starting on deck firstDeck and each one after
+ * on the deck after the last deck of the game before. Totals are added
+ * to stats.
+ * Returns MOVE_OK, or MOVE_INVALID as soon as a strategy makes an
+ * invalid move, or MOVE_NO_DECK as soon as the decks run out.
+ */
+int simulate_batch(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, const Strategy* seats[],
+        BatchStats* stats) {
+    Game game;
+    void* states[MAX_PLAYERS];
+    int result = MOVE_OK;
+
+    for (long g = 0; g < numGames && result == MOVE_OK; g++) {
+        init_game(&game, numPlayers, corpus, firstDeck);
+        for (int i = 0; i < numPlayers; i++) {
+            states[i] = seats[i]->create(numPlayers, i + SHIFT);
+        }
+        result = play_batch_game(&game, seats, states, stats);
+        for (int i = 0; i < numPlayers; i++) {
+            if (seats[i]->destroy != NULL) {
+                seats[i]->destroy(states[i]);
+            }
+        }
+        firstDeck = game.deckIndex;
+    }
+    return result;
+}
+
+/*
+ * Adds the totals in stats to total.
+ */
+void add_stats(BatchStats* total, const BatchStats* stats) {
+    total->games += stats->games;
+    total->rounds += stats->rounds;
+    total->turns += stats->turns;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        total->wins[i] += stats->wins[i];
+        total->points[i] += stats->points[i];
+    }
+}
+
+/*
+ * Plays the first round of a game of numPlayers players on each of
+ * numDecks decks of corpus in turn, from deck firstDeck, between the
+ * strategies in seats (started afresh for every round). How each round
+ * went is added to stats. Returns MOVE_OK, or MOVE_INVALID as soon as a
+ * strategy makes an invalid move, or MOVE_NO_DECK as soon as the decks
+ * run out.
+ */
+int simulate_rounds(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numDecks, const Strategy* seats[],
+        RoundStats* stats) {
+    Game game;
+    BatchStats round;
+    void* states[MAX_PLAYERS];
+    int result = MOVE_OK;
+
+    for (long d = 0; d < numDecks && result == MOVE_OK; d++) {
+        init_game(&game, numPlayers, corpus, firstDeck);
+        for (int i = 0; i < numPlayers; i++) {
+            states[i] = seats[i]->create(numPlayers, i + SHIFT);
+        }
+        memset(&round, 0, sizeof(BatchStats));
+        result = play_batch_round(&game, seats, states, &round);
+        for (int i = 0; i < numPlayers; i++) {
+            if (seats[i]->destroy != NULL) {
+                seats[i]->destroy(states[i]);
+            }
+        }
+        if (result != MOVE_OK) {
+            break;
+        }
+        //the winners are the seats that scored
+        int winners = 0;
+        for (int i = 0; i < numPlayers; i++) {
+            if (game.scores[i] > 0) {
+                winners |= 1 << i;
+                stats->points[i]++;
+            }
+        }
+        stats->rounds++;
+        stats->turns += round.turns;
+        stats->winners[winners]++;
+        stats->lengths[round.turns]++;
+        firstDeck = game.deckIndex;
+    }
+    return result;
+}
+
+/*
+ * Adds the totals in stats to total.
+ */
+void add_round_stats(RoundStats* total, const RoundStats* stats) {
+    total->rounds += stats->rounds;
+    total->turns += stats->turns;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        total->points[i] += stats->points[i];
+    }
+    for (int i = 0; i < 1 << MAX_PLAYERS; i++) {
+        total->winners[i] += stats->winners[i];
+    }
+    for (int i = 0; i < DECK_SIZE; i++) {
+        total->lengths[i] += stats->lengths[i];
+    }
+}
+
+/*
+ * Loads the strategy plugin at path (see STRATEGY_SYMBOL). Returns NULL
+ * if it cannot be loaded or was built for another STRATEGY_ABI. The
+ * plugin stays loaded for the life of the process.
+ */
+const Strategy* load_strategy(const char* path) {
+    void* plugin = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    const Strategy* (*entry)(int abi);
+    const Strategy* strategy;
+
+    if (plugin == NULL) {
+        return NULL;
+    }
+    *(void**)&entry = dlsym(plugin, STRATEGY_SYMBOL);
+    strategy = entry == NULL ? NULL : entry(STRATEGY_ABI);
+    if (strategy == NULL || strategy->create == NULL ||
+            strategy->on_yourturn == NULL) {
+        dlclose(plugin);
+        return NULL;
+    }
+    return strategy;
+}
+
+/*
+ * Returns the bundled strategy called name, or the plugin at path for a
+ * name of the form lib:path. Returns NULL if there is no such strategy.
+ */
+const Strategy* find_strategy(const char* name) {
+    if (strncmp(name, STRATEGY_PREFIX, strlen(STRATEGY_PREFIX)) == 0) {
+        return load_strategy(name + strlen(STRATEGY_PREFIX));
+    }
+    if (strcmp(name, "basic") == 0) {
+        return &basicStrategy;
+    }
+    if (strcmp(name, "ismcts") == 0) {
+        return &ismctsStrategy;
+    }
+    return NULL;
+}
@@ -0,0 +1,197 @@
+/*
+ * The Love Letter rules engine (libloveletter)
+ *
+ * All of the rules live here as pure state transitions on a Game. Nothing
+ * in the engine reads or writes a stream: the hub turns Outcomes into
+ * protocol messages and commentary, while simulate_batch feeds them
+ * straight to in-process strategies.
+ */
+
+#ifndef LOVELETTER_H
+#define LOVELETTER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "strategy.h"
+
+/* Game limits */
+#define MIN_PLAYERS 2
+#define MAX_PLAYERS 4
+#define DECK_SIZE 16
+#define WINNING_SCORE 4
+/*A common shift for chars to ints and vice versa*/
+#define SHIFT 65
+/* The number of different decks (orderings of the 16 cards) */
+#define NUM_ORDERINGS 10897286400ULL
+/* Binary deck corpora: a header (CORPUS_MAGIC, then a byte each for the
+ * version and the bytes per deck, 2 spare bytes, the number of decks as
+ * 8 bytes and a 32 bit FNV-1a checksum of the decks, all little endian)
+ * followed by each deck as its rank (see rank_deck) in CORPUS_DECK_SIZE
+ * little endian bytes, so deck i is at CORPUS_HEADER + i *
+ * CORPUS_DECK_SIZE */
+#define CORPUS_MAGIC "LLDK"
+#define CORPUS_VERSION 1
+#define CORPUS_HEADER 20
+#define CORPUS_DECK_SIZE 5
+/* 2^64 over the golden ratio: the splitmix64 increment, and a multiplier
+ * that spreads numbers over 64 bits */
+#define GOLDEN 0x9e3779b97f4a7c15ULL
+/* Return values of apply_move and simulate_batch */
+#define MOVE_OK 0
+#define MOVE_INVALID 1
+#define MOVE_NO_DECK 2
+
+/* A generic Deck struct to contain a list of 16 deck cards
+ * - cards: a list of 16 cards
+ * */
+typedef struct Deck {
+    char cards[DECK_SIZE];
+} Deck;
+
+/* The copies of each card in a deck, by card (1 to 8, 0 is no card) */
+static const int cardCopies[9] = {0, 5, 2, 2, 2, 2, 1, 1, 1};
+
+/* Decks being read from a deck file as they are wanted (see decks.c) */
+typedef struct DeckStream DeckStream;
+
+/* Every deck of a deck file, in file order, or decks made up from a
+ * seed or read from a stream as they are wanted, or every possible deck.
+ * Games go through the decks in turn, starting over after the last.
+ * - decks: the decks, one after another, or NULL if they are generated
+ *   or streamed
+ * - numDecks: the number of decks (LONG_MAX for a stream)
+ * - seed: the seed generated decks come from
+ * - stream: the stream decks are read from, or NULL
+ * - ranked: true if deck i is the deck of rank i (see rank_deck)
+ */
+typedef struct DeckCorpus {
+    Deck* decks;
+    long numDecks;
+    uint64_t seed;
+    DeckStream* stream;
+    bool ranked;
+} DeckCorpus;
+
+/* A player struct
+ * - outOfRound: boolean for out of round status
+ * - label: the player label
+ * - holding: what the player is holding
+ * - protected: boolean for the protection status
+ */
+typedef struct Player {
+    bool outOfRound;
+    char label;
+    char holding;
+    bool protected;
+} Player;
+
+/* The result of a successful move
+ * - event: the thishappened to send to every player
+ * - numReplaced: how many replace messages the move caused (0 to 2)
+ * - replacedSeat: the seat receiving each replace, in sending order
+ * - replacedCard: the card sent in each replace
+ */
+typedef struct Outcome {
+    Event event;
+    int numReplaced;
+    int replacedSeat[2];
+    char replacedCard[2];
+} Outcome;
+
+/* A game struct containing all the information about this game
+ * - round: the number of rounds finished
+ * - numPlayers: the number of players
+ * - corpus: the decks the game is played with
+ * - deckIndex: the index in corpus of the deck for this round
+ * - deck: a copy of the game deck (for this round)
+ * - pos: the pos of the next card to get in the deck
+ * - turn: the seat to check first for the next turn
+ * - given: the card dealt for the turn in progress
+ * - roundOver: true once the current round has ended
+ * - scores: the scores for each player
+ * - players: the players in the game
+ */
+typedef struct Game {
+    int round;
+    int numPlayers;
+    const struct DeckCorpus* corpus;
+    long deckIndex;
+    struct Deck deck;
+    int pos;
+    int turn;
+    char given;
+    bool roundOver;
+    int scores[MAX_PLAYERS];
+    struct Player players[MAX_PLAYERS];
+} Game;
+
+/* Totals gathered by simulate_batch
+ * - games: games played
+ * - rounds: rounds played
+ * - turns: moves applied
+ * - wins: games won by each seat (a shared win counts for every winner)
+ * - points: rounds won by each seat
+ */
+typedef struct BatchStats {
+    long games;
+    long rounds;
+    long turns;
+    long wins[MAX_PLAYERS];
+    long points[MAX_PLAYERS];
+} BatchStats;
+
+/* Totals gathered by simulate_rounds
+ * - rounds: rounds played
+ * - turns: moves applied
+ * - points: rounds won by each seat (a shared win counts for every winner)
+ * - winners: rounds won by each set of seats (bit i set for seat i)
+ * - lengths: rounds taking each number of turns
+ */
+typedef struct RoundStats {
+    long rounds;
+    long turns;
+    long points[MAX_PLAYERS];
+    long winners[1 << MAX_PLAYERS];
+    long lengths[DECK_SIZE];
+} RoundStats;
+
+/* Decks */
+bool check_sum(const char input[DECK_SIZE]);
+uint64_t rank_deck(const Deck* deck);
+bool unrank_deck(uint64_t rank, Deck* deck);
+DeckCorpus* load_decks(FILE* deckFile);
+DeckCorpus* generate_decks(uint64_t seed, long numDecks);
+DeckCorpus* stream_decks(int fd, bool wrap);
+DeckCorpus* enumerate_decks(void);
+bool get_deck(const DeckCorpus* corpus, long index, Deck* deck);
+bool write_corpus(FILE* corpusFile, const DeckCorpus* corpus);
+void free_corpus(DeckCorpus* corpus);
+
+/* Game state transitions */
+void init_game(Game* game, int numPlayers, const DeckCorpus* corpus,
+        long deckIndex);
+bool start_round(Game* game);
+int next_turn(Game* game);
+int apply_move(Game* game, int player, const char move[3],
+        Outcome* outcome);
+void finish_round(Game* game);
+
+/* Game queries */
+bool check_end_of_round(const Game* game);
+bool target_available(const Game* game, int player);
+bool is_winner(const Game* game);
+
+/* Batch simulation */
+int simulate_batch(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, const Strategy* seats[],
+        BatchStats* stats);
+void add_stats(BatchStats* total, const BatchStats* stats);
+int simulate_rounds(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numDecks, const Strategy* seats[],
+        RoundStats* stats);
+void add_round_stats(RoundStats* total, const RoundStats* stats);
+int simulate_lockstep(const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numGames, BatchStats* stats);
+
+#endif
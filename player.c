@@ -7,12 +7,23 @@
 #include <string.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include "frame.h"
+#include "wire.h"
+#include "shm.h"
+#include "trace.h"
+#include "strategy.h"
+#include "belief.h"
 
 /*Defined constants */
 #define USAGE_NUMBER 3 //the correct number of args for the program
 #define FIRST 0 //index 0 in array is first position
 #define SECOND 1 //index 1 is second position
 #define MAX_CARDS 16 //The max cards a player can play in a two player game
+#define MAX_MESSAGE 21 //The longest message from the hub (without \n)
+#define HUB_TIMEOUT 50 //ms asleep on shared memory before checking the hub
 /*Exit condition values*/
 #define NORMAL_EXIT 0
 #define USAGE_EXIT 1
@@ -23,18 +34,37 @@
 /*Common shifts for ints and chars*/
 #define SHIFT_LETTER 65
 #define SHIFT_NUMBER 48
+/*Where status lines go: stderr, the trace ring, or nowhere*/
+#define REPORT_STDERR 0
+#define REPORT_TRACE 1
+#define REPORT_NONE 2
 
 /* The ThisPlayer struct (known for each instance of player process)
  * - label: the player's label
  * - cards: the cards the player is holding
  * - numberOthers: the number of players in the game
  * - addNext: which card to add next (either 1 or 0, index of cards)
+ * - binary: if the hub took up the binary protocol
+ * - channel: the shared memory channel to the hub, or NULL for the pipes
+ * - hubBell: the bell to ring after writing to the channel
+ * - spins: how long to busy-poll the channel before sleeping
+ * - belief: what this player believes of the others' cards this round
+ * - strategy: the strategy named in STRATEGY_ENV, which makes the moves
+ *   in place of make_move, or NULL
+ * - state: the strategy's state for this game
  */
 typedef struct {
     char label; 
     int cards[2]; 
     int numberOthers; 
     int addNext; 
+    bool binary;
+    Channel *channel;
+    Bell *hubBell;
+    int spins;
+    Belief belief;
+    const Strategy *strategy;
+    void *state;
 } ThisPlayer;
 
 /* A generic player struct (one generated per player, including this one) 
@@ -52,10 +82,18 @@ typedef struct {
     int numberPlayed; 
 } Player;
 
+/* Where status lines go, and the ring they go to when tracing (global
+ * so that the signal handlers can flush it) */
+static int reporting = REPORT_STDERR;
+static Trace *trace = NULL;
+
 /*
  * Exits the process with the given exitStatus.
  */ 
 void exit_with(int exitStatus) {
+    if (exitStatus != NORMAL_EXIT && trace != NULL) {
+        flush_trace(trace);
+    }
     switch(exitStatus) {
         case 0:
             exit(0);
@@ -85,11 +123,62 @@ void exit_with(int exitStatus) {
     }
 }
 
+/*
+ * Returns the designator for a player's state: '-' if they are out of the
+ * round, '*' if they are protected, or ' '.
+ */
+char designator_of(Player *player) {
+    if (player->outOfRound) {
+        return '-';
+    } else if (player->protected) {
+        return '*';
+    }
+    return ' ';
+}
+
+/*
+ * Records the status information print_status would print as one record
+ * in the trace ring.
+ */
+void trace_status(Player *players, ThisPlayer *thisPlayer) {
+    unsigned char record[TRACE_MAX_RECORD];
+    int length = 0;
+
+    for (int i = 0; i < thisPlayer->numberOthers; i++) {
+        int numberPlayed = players[i].numberPlayed;
+        record[length++] = designator_of(&players[i]);
+        record[length++] = numberPlayed;
+        for (int j = 0; j < numberPlayed; j++) {
+            record[length++] = players[i].playedCards[j] + SHIFT_NUMBER;
+        }
+    }
+    record[length++] = thisPlayer->cards[0] ? thisPlayer->cards[0] : '-';
+    record[length++] = thisPlayer->cards[1] ? thisPlayer->cards[1] : '-';
+    trace_record(trace, TRACE_STATUS, record, length);
+}
+
+/*
+ * Reports a message of length characters from the hub.
+ */
+void report_from_hub(const char *message, int length) {
+    if (reporting == REPORT_STDERR) {
+        fprintf(stderr, "From hub:%.*s\n", length, message);
+    } else if (reporting == REPORT_TRACE) {
+        trace_record(trace, TRACE_FROM_HUB, message, length);
+    }
+}
+
 /*
  * Extracts player status information from players and prints it to 
- * standard error.
+ * standard error, or records it in the trace ring.
  */
 void print_status(Player *players, ThisPlayer *thisPlayer) {
+    if (reporting == REPORT_TRACE) {
+        trace_status(players, thisPlayer);
+    }
+    if (reporting != REPORT_STDERR) {
+        return;
+    }
     /* The designator for a player's state (outOfRound or eliminated and an 
     * array of chars for the cards played) */
     char designator, string[8];
@@ -100,13 +189,7 @@ void print_status(Player *players, ThisPlayer *thisPlayer) {
     for (int i = 0; i < thisPlayer->numberOthers; i++) {
         //set the designator according to if they are outOfRound or
         //protected, or neither
-        if (players[i].outOfRound) {
-            designator = '-';
-        } else if (players[i].protected) {
-            designator = '*';
-        } else {
-            designator = ' ';
-        }
+        designator = designator_of(&players[i]);
         //add in the cards they played to the string
         for (int j = 0; j < players[i].numberPlayed; j++) {
             string[j] = players[i].playedCards[j] + SHIFT_NUMBER;
@@ -200,6 +283,20 @@ bool check_string(char *message, int numberPlayers) {
     return returnValue;
 }
 
+/*
+ * Reads the fields of a thishappened (pcpc/pcp, already checked) into
+ * event.
+ */
+void read_event(const char *message, Event *event) {
+    event->player = message[0];
+    event->card = message[1];
+    event->target = message[2];
+    event->guess = message[3];
+    event->dropper = message[5];
+    event->dropped = message[6];
+    event->eliminated = message[7];
+}
+
 /*
  * Update the state of the game after thishappend has been received.
  * Checks range of all values in message which is of the form:
@@ -218,11 +315,14 @@ void update_state(char *message, ThisPlayer *thisPlayer, Player *players) {
     char moveMaker = message[0]; //player who played card
     char cardPlayed = message[1]; //card that was played
     char eliminatedPlayer = message[7]; //the elimated player    
+    Event event; //the message's fields
     
     //checkk the message does not contain bad chars
     if (!(check_string(message, thisPlayer->numberOthers))) {
         exit_with(MESSAGE_EXIT);
     }
+    read_event(message, &event);
+    update_belief(&thisPlayer->belief, &event, thisPlayer->cards[FIRST]);
   
     //if moveMaker is not this player (as internal state updated before
     //thishappened message), then update that player's information  
@@ -280,11 +380,13 @@ void add_card(char card, bool newround, ThisPlayer *thisPlayer,
     if (newround) {
         thisPlayer->cards[0] = card;
         thisPlayer->cards[1] = 0;
+        reset_belief(&thisPlayer->belief, thisPlayer->numberOthers,
+                thisPlayer->label);
         for (int i = 0; i < thisPlayer->numberOthers; i++) {
             players[i].protected = false;
             players[i].outOfRound = false;
             players[i].numberPlayed = 0;
-            for (int j = 0; j < 8; j++) {
+            for (int j = 0; j < MAX_CARDS; j++) {
                 players[i].playedCards[j] = 0;
             }
         }
@@ -298,124 +400,123 @@ void add_card(char card, bool newround, ThisPlayer *thisPlayer,
     
     //next time add to position 1
     thisPlayer->addNext = 1;
+    belief_see_card(&thisPlayer->belief, card);
 }
 
 /*  
- *  Returns the card that should be guessed. Returns '-' unless the card
- *  is a 1. If the card is a 1, guess is chosen by choosing the highest
- *  card that has not yet been played.
+ *  Returns the card that should be guessed at target (an index). Returns
+ *  '-' unless the card is a 1. If the card is a 1, guess is the card the
+ *  target most likely holds, other than a 1. Costs the same however
+ *  much of the round has been played.
  */
-int get_guess(int choice, ThisPlayer *thisPlayer, Player *players) {
+int get_guess(int choice, int target, ThisPlayer *thisPlayer) {
     //if choice is not one, then return '-' as there is no guess
     if (choice != 1) {
         return (int)'-';
-    } else {
-        // Set up that maximum playable numbers for each card
-        int max[] = {5, 2, 2, 2, 2, 1, 1, 1};
-        bool isAllPlayed[8];
-        int numberPlayed[8];
-        int card;
-        int returnCard = 0;
-        
-        //get how many of each card have been played    
-        for (int i = 0; i < thisPlayer->numberOthers; i++) {
-            for(int j = 0; j < 16; j++) {
-                card = players[i].playedCards[j];
-                if (card != 0) {
-                    numberPlayed[card - 1] += 1;
-                }
-            }
+    }
+    //cannot guess 1
+    return likeliest_card(&thisPlayer->belief, target, '2');
+}
 
-        }
-        
-        //check if the maximum number has been played
-        for (int m = 0; m < 8; m++) {
-            if (numberPlayed[m] == max[m]) {
-                isAllPlayed[m] = true;
-            }
-        }   
-        
-        //get the highest card that has not all been played
-        for (int n = 7; n > 0; n--) {
-            if (isAllPlayed[n] == false) {
-                returnCard = n + 1;
-                break;
-            }
-        }
-        //cannot guess 1
-        if (returnCard == 0) {
-            return '-';
+/*
+ * Returns how good a target target (an index) is for choice, when this
+ * player keeps kept (a card value), from what it believes target holds:
+ * - 1: the chance the guess is right
+ * - 3: the chance of winning the compare less the chance of losing it
+ * - 5 and 6: the card target can be expected to hold, as 5 makes them
+ *   drop it and 6 takes it
+ */
+double rate_target(ThisPlayer *thisPlayer, int target, int choice,
+        int kept) {
+    Belief *belief = &thisPlayer->belief;
+    double rating = 0;
+
+    if (choice == 1) {
+        char guess = get_guess(choice, target, thisPlayer);
+        return guess == '-' ? 0 : card_chance(belief, target, guess);
+    }
+    for (int c = 1; c <= 8; c++) {
+        double chance = card_chance(belief, target, c + SHIFT_NUMBER);
+        if (choice == 3) {
+            rating += c < kept ? chance : (c > kept ? -chance : 0);
         } else {
-            return returnCard + 48;
+            rating += c * chance;
         }
     }
+    return rating;
 }
 
 /*
  * Perform a discard by sending a message to standard out of the form
  * c1pc2 where c1 is the choice, p is the label of the target  and c2 
- * is the guess. Also sends to stderr a message of the form: To hub:c1pc2\n
+ * is the guess. Also reports a message of the form: To hub:c1pc2\n
  */ 
 void discard(int choice, char guess, char label, ThisPlayer *thisPlayer) {
-    fprintf(stdout, "%d%c%c\n", choice, label,
-            guess);
-    fflush(stdout);
-    fprintf(stderr, "To hub:%d%c%c\n", choice, label,
-            guess);
+    char reply[8]; //the reply in whichever protocol
+    struct iovec part = {reply, 0};
+
+    if (thisPlayer->binary) {
+        encode_move((unsigned char*)reply, choice + SHIFT_NUMBER, label,
+                guess);
+        part.iov_len = WIRE_MOVE_SIZE;
+    } else {
+        part.iov_len = sprintf(reply, "%d%c%c\n", choice, label, guess);
+    }
+    if (thisPlayer->channel != NULL) {
+        ring_write(&thisPlayer->channel->toHub, thisPlayer->hubBell, &part,
+                1);
+    } else {
+        fwrite(reply, 1, part.iov_len, stdout);
+        fflush(stdout);
+    }
+    if (reporting == REPORT_STDERR) {
+        fprintf(stderr, "To hub:%d%c%c\n", choice, label, guess);
+    } else if (reporting == REPORT_TRACE) {
+        char move[3] = {choice + SHIFT_NUMBER, label, guess};
+        trace_record(trace, TRACE_TO_HUB, move, 3);
+    }
 }
 
 /*
- * Find and target a player given the choice. Calls get_guess to get the
- * guess card for the choice. Target is chosen by selecting the first
- * unprotected and still playing player following thisPlayer. For example,
- * if thisPlayer's label is B in a 4 player game, then C and D will be 
+ * Find and target a player given the choice, which thisPlayer plays from
+ * its two cards. Calls get_guess to get the guess card for the choice.
+ * Target is chosen by rate_target from the unprotected and still playing
+ * players, the first following thisPlayer winning a tie. For example, if
+ * thisPlayer's label is B in a 4 player game, then C and D will be
  * checked as targets before A is. If no target is found, then we target
- * no one. 
+ * no one, or ourselves with a 5.
  */ 
 void target_player(Player *players, ThisPlayer *thisPlayer, int choice) {
-    /*The guess to be made*/
-    int guess;
-    bool targetSomeone = false; //no one has been targeted
+    int self = thisPlayer->label - SHIFT_LETTER; //this player's index
+    int kept = thisPlayer->cards[FIRST] - SHIFT_NUMBER == choice ?
+            thisPlayer->cards[SECOND] - SHIFT_NUMBER :
+            thisPlayer->cards[FIRST] - SHIFT_NUMBER; //the card kept
+    int best = -1; //the target, if there is one
+    double bestRating = 0;
+
     //new round, no longer protected
-    players[thisPlayer->label - SHIFT_LETTER].protected = false;
-    //Check all players after thisPlayer in designator (i.e. if we are
-    //B then check C and D - assuming 4 players)
-    for (int i = (thisPlayer->label - SHIFT_LETTER) + 1; i <
-            thisPlayer->numberOthers; i++) {
+    players[self].protected = false;
+    for (int j = 1; j < thisPlayer->numberOthers; j++) {
+        int i = (self + j) % thisPlayer->numberOthers;
         //if unprotected and not out of round
         if (!(players[i].protected) && !(players[i].outOfRound)) {
-            //target them by getting the guess and discarding the choice
-            guess = get_guess(choice, thisPlayer, players);
-            discard(choice, guess, players[i].label, thisPlayer);
-            //someone has been targeted
-            targetSomeone = true;
-            break;
-        } 
-    }
-    //if there is no one to target we must target no-one if
-    //1,3 or 6. If the card is a 5, we target ourselves
-    for (int i = 0; i < thisPlayer->label - SHIFT_LETTER + 1; i++) {
-        if (!(players[i].protected) && !(players[i].outOfRound) &&
-                targetSomeone == false) {
-            guess = get_guess(choice, thisPlayer, players);
-    
-            //if we are targeting ourselves
-            if (i == (thisPlayer->label - SHIFT_LETTER) && choice == 5) {
-                //if choice is a 5 we are targeting ourself
-                discard(choice, '-', thisPlayer->label, thisPlayer);
-            } else if (i == (thisPlayer->label - SHIFT_LETTER) && 
-                    choice != 5) {
-                //choice is not a 5,we target no one, but still need guess 
-                //the guess will be '-' unless choice is 1
-                discard(choice, '-', '-', thisPlayer);
-            } else {
-                //player is not us, we can target them
-                discard(choice, guess, players[i].label, thisPlayer);
+            double rating = rate_target(thisPlayer, i, choice, kept);
+            if (best < 0 || rating > bestRating) {
+                best = i;
+                bestRating = rating;
             }
-            targetSomeone = true;
-            break;
         }
     }
+    if (best >= 0) {
+        discard(choice, get_guess(choice, best, thisPlayer),
+                players[best].label, thisPlayer);
+    } else if (choice == 5) {
+        //if choice is a 5 we are targeting ourself
+        discard(choice, '-', thisPlayer->label, thisPlayer);
+    } else {
+        //we target no one, so there is no guess either
+        discard(choice, '-', '-', thisPlayer);
+    }
 }
 
 /*
@@ -501,165 +602,487 @@ void make_move(Player *players, ThisPlayer *thisPlayer) {
 }
 
 /*
- * Check the string scoreMessage is appropriate to the number numberPlayers
- * and that the scores are within the valid range of 0 to 4 inclusive.
- * Exits the program if error found. A valid score message is of the form:
- * - scores i j...\n -> with i j... equal to numberPlayers. 
- * In a 3 player game, scores will be of form: scores i j k\n.
+ * Makes the move thisPlayer's strategy picks once it has been dealt card,
+ * and updates thisPlayer to match as make_move does.
  */
-void check_score_message(char *scoreMessage, int numberPlayers) {
-    //copy the string
-    char *thisCopy = malloc(sizeof(char) * strlen(scoreMessage));
-    thisCopy = strcpy(thisCopy, scoreMessage);
- 
-    //split the string
-    char *secondArg = strtok(scoreMessage, " ");
-    secondArg = strtok(NULL, " ");
-    int scoreSize = 6; //size of scores string
-
-    //check range of second argument of string (which is the first score)
-    if (strlen(secondArg) != 1 || secondArg[0] < '0' || 
-            secondArg[0] > '4') {
-        exit_with(MESSAGE_EXIT);
+void strategy_move(Player *players, ThisPlayer *thisPlayer, char card) {
+    char move[3]; //the move, as c1pc2
+    int choice;
+
+    thisPlayer->strategy->on_yourturn(thisPlayer->state, card, move);
+    choice = move[0] - SHIFT_NUMBER;
+    discard(choice, move[2], move[1], thisPlayer);
+    //keep whichever card was not played
+    if (thisPlayer->cards[FIRST] == move[0]) {
+        thisPlayer->cards[FIRST] = thisPlayer->cards[SECOND];
     }
-    int numScores = 1; //already one score
-    char* strScore;
+    thisPlayer->cards[SECOND] = 0;
+    update_internal_state(players, thisPlayer, choice);
+}
 
-    //loop through the rest of the message, check range of scores and
-    //the number of them
-    while ((strScore = strtok(NULL, " ")) != NULL) {
-        numScores++;
-        if (strlen(strScore) != 1 || strScore[0] > '4' || 
-                strScore[0] < '0') {
-            exit_with(MESSAGE_EXIT);
+/*
+ * Resets thisPlayer and players for a newgame message: the same process
+ * goes on to play another game from scratch.
+ */
+void new_game(Player *players, ThisPlayer *thisPlayer) {
+    thisPlayer->cards[0] = 0;
+    thisPlayer->cards[1] = 0;
+    thisPlayer->addNext = 1;
+    reset_belief(&thisPlayer->belief, thisPlayer->numberOthers,
+            thisPlayer->label);
+    for (int i = 0; i < thisPlayer->numberOthers; i++) {
+        players[i].protected = false;
+        players[i].outOfRound = false;
+        players[i].numberPlayed = 0;
+        for (int j = 0; j < MAX_CARDS; j++) {
+            players[i].playedCards[j] = 0;
         }
     }
-    //test length of the string to make sure it is the length of 'scores '
-    //and the number of players (i.e. in 2 player game: 'scores' + ' 1'
-    //+ ' 2' gives length of 6 + 2 + 2 = 10
-    if (strlen(thisCopy) != (scoreSize + numberPlayers * 2)) {
-        exit_with(MESSAGE_EXIT);
+    //the strategy starts over too
+    if (thisPlayer->strategy != NULL) {
+        if (thisPlayer->strategy->destroy != NULL) {
+            thisPlayer->strategy->destroy(thisPlayer->state);
+        }
+        thisPlayer->state = thisPlayer->strategy->create(
+                thisPlayer->numberOthers, thisPlayer->label);
     }
-    //if there are more scores then players, then exit
-    if (numScores > numberPlayers) {
-        exit_with(MESSAGE_EXIT);
+}
+
+/*
+ * Checks the scores of a scores message (what follows the word) are
+ * exactly one score from 0 to 4 for each of numberPlayers players, each
+ * after a space: " i j..." with i j... equal to numberPlayers. In a 3
+ * player game the scores will be of form: " i j k".
+ */
+bool check_scores(const char *scores, int length, int numberPlayers) {
+    if (length != 2 * numberPlayers) {
+        return false;
+    }
+    for (int i = 0; i < length; i += 2) {
+        if (scores[i] != ' ' || scores[i + 1] < '0' ||
+                scores[i + 1] > '4') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Works out which message message is (length chars, in place in the read
+ * buffer and '\0' terminated), checking it is exactly of one of the
+ * forms:
+ * - newround c, yourturn c or replace c
+ * - thishappened pcpc/pcp
+ * - scores i j... -> to number of players
+ * - newgame or gameover
+ * Points argument at what follows the word and its space. Returns the
+ * wire type of the message, or 0 if it is none of them. Nothing is
+ * copied or allocated.
+ */
+int parse_message(char *message, int length, int numberPlayers,
+        char **argument) {
+    int type; //the message the first letters say it must be
+    int word; //the length of its word
+
+    //the first letter (and the fourth for the n words) tells them apart
+    switch (message[0]) {
+        case 'n':
+            type = length > 3 && message[3] == 'g' ? WIRE_NEWGAME :
+                    WIRE_NEWROUND;
+            break;
+        case 'y':
+            type = WIRE_YOURTURN;
+            break;
+        case 't':
+            type = WIRE_THISHAPPENED;
+            break;
+        case 'r':
+            type = WIRE_REPLACE;
+            break;
+        case 's':
+            type = WIRE_SCORES;
+            break;
+        case 'g':
+            type = WIRE_GAMEOVER;
+            break;
+        default:
+            return 0;
+    }
+    word = strlen(wire_name(type));
+    if (length < word || memcmp(message, wire_name(type), word) != 0) {
+        return 0;
+    }
+    *argument = message + word + 1;
+
+    //then what follows the word must be just right for it
+    switch (type) {
+        case WIRE_NEWROUND:
+        case WIRE_YOURTURN:
+        case WIRE_REPLACE:
+            //a single card
+            return length == word + 2 && message[word] == ' ' ? type : 0;
+        case WIRE_THISHAPPENED:
+            //pcpc/pcp, checked when it is used
+            return length == word + 9 && message[word] == ' ' ? type : 0;
+        case WIRE_SCORES:
+            return check_scores(message + word, length - word,
+                    numberPlayers) ? type : 0;
+        default:
+            //nothing at all
+            return length == word ? type : 0;
     }
 }
 
 /*
- * Parses the string given by message and calls the appropriate
- * function to handle the input. Checks the size of the input, exits
- * the program if no match found. Match cases are: 
- * - newround c\n
- * - yourturn c\n
- * - thishappened pcpc/pcp\n
- * - replace c\n
- * - scores i j...\n -> to number of players
+ * Works out which message a binary protocol record is, the same way
+ * parse_message does for the text form. Its argument (a card, pcpc/pcp
+ * or i j...) is written out into argument as the text form has it.
+ * Returns the wire type of the message, or 0 if it is not a valid one.
+ */
+int parse_record(const unsigned char *record, int numberPlayers,
+        char argument[9]) {
+    switch (record[0]) {
+        case WIRE_NEWROUND:
+        case WIRE_YOURTURN:
+        case WIRE_REPLACE:
+            argument[0] = decode_card(record[1]);
+            argument[1] = '\0';
+            break;
+        case WIRE_THISHAPPENED:
+            decode_event(record, argument);
+            break;
+        case WIRE_SCORES:
+            //every score must be in range, and unused ones must be 0
+            for (int i = 0; i < 4; i++) {
+                int score = (record[1 + i / 2] >> (4 * (i % 2))) & 0xf;
+                if (score > 4 || (i >= numberPlayers && score != 0)) {
+                    return 0;
+                }
+                if (i < numberPlayers) {
+                    argument[2 * i] = score + SHIFT_NUMBER;
+                    argument[2 * i + 1] = ' ';
+                }
+            }
+            argument[2 * numberPlayers - 1] = '\0';
+            break;
+        case WIRE_NEWGAME:
+        case WIRE_GAMEOVER:
+            break;
+        default:
+            return 0;
+    }
+    return record[0];
+}
+
+/*
+ * Calls the appropriate function to handle a message of the given type
+ * (other than newgame and gameover), with argument as found by
+ * parse_message or parse_record. Match cases are:
+ * - newround c
+ * - yourturn c
+ * - thishappened pcpc/pcp
+ * - replace c
+ * - scores i j... (already checked)
+ * A strategy, if there is one, is told of each message once it has been
+ * checked.
  */ 
-void parse_message(Player *players, ThisPlayer *thisPlayer, 
-        char *message) {
-    //copy for checking the length
-    char *keepCopy = malloc(sizeof(char) * strlen(message));
-    keepCopy = strcpy(keepCopy, message);
-    char *token; //a sub part of a string
-    token = strtok(message, " "); //split string
-    char *secondArg = strtok(NULL, " "); //get second argument
-    
-    //check if secondArg too long (must be single char or of form pcpc/pcp
-    //for thishappened)
-    if ((secondArg != NULL && strlen(secondArg) != 1 && 
-            strlen(secondArg) != 8) || secondArg == NULL) {
+void handle_message(Player *players, ThisPlayer *thisPlayer, int type,
+        char *argument) {
+    const Strategy *strategy = thisPlayer->strategy;
+    int scores[4]; //the scores of a scores message
+    Event event; //the fields of a thishappened
+
+    switch (type) {
+        case WIRE_NEWROUND:
+            // add card to hand, pass true as it is a new round
+            add_card(argument[0], true, thisPlayer, players);
+            if (strategy != NULL) {
+                strategy->on_newround(thisPlayer->state, argument[0]);
+            }
+            break;
+        case WIRE_YOURTURN:
+            // add card (c) and make a move
+            add_card(argument[0], false, thisPlayer, players);
+            print_status(players, thisPlayer); //print second status info
+            if (strategy != NULL) {
+                strategy_move(players, thisPlayer, argument[0]);
+            } else {
+                make_move(players, thisPlayer);
+            }
+            break;
+        case WIRE_THISHAPPENED:
+            //update state of other players
+            update_state(argument, thisPlayer, players);
+            if (strategy != NULL) {
+                read_event(argument, &event);
+                strategy->on_thishappened(thisPlayer->state, &event);
+            }
+            break;
+        case WIRE_REPLACE:
+            if (argument[0] < '1' || argument[0] > '8') {
+                exit_with(MESSAGE_EXIT);
+            }
+            //replace card we are holding
+            belief_replace(&thisPlayer->belief, thisPlayer->cards[FIRST],
+                    argument[0]);
+            thisPlayer->cards[FIRST] = argument[0];
+            if (strategy != NULL) {
+                strategy->on_replace(thisPlayer->state, argument[0]);
+            }
+            break;
+        case WIRE_SCORES:
+            if (strategy != NULL) {
+                for (int i = 0; i < thisPlayer->numberOthers; i++) {
+                    scores[i] = argument[2 * i] - SHIFT_NUMBER;
+                }
+                strategy->on_scores(thisPlayer->state, scores,
+                        thisPlayer->numberOthers);
+            }
+            break;
+        default:
+            //it was none of the above, exit with message error
+            exit_with(MESSAGE_EXIT);
+    }
+}
+
+/*
+ * Returns true if the hub has closed its pipe to this player, without
+ * blocking. Only used on shared memory, where nothing else comes down
+ * the pipe.
+ */
+bool hub_gone(void) {
+    struct pollfd hub = {STDIN_FILENO, POLLIN, 0};
+    char discard;
+
+    if (poll(&hub, 1, 0) <= 0) {
+        return false;
+    }
+    return (hub.revents & (POLLHUP | POLLERR)) ||
+            read(STDIN_FILENO, &discard, 1) == 0;
+}
+
+/*
+ * Reads more from the hub into framer, waiting until there is some. On
+ * shared memory the wait is on this player's bell, with a look at the
+ * pipe every so often in case the hub has gone.
+ */
+void read_hub(Framer *framer, ThisPlayer *thisPlayer) {
+    Channel *channel = thisPlayer->channel;
+
+    if (channel == NULL) {
+        read_frames(framer);
+        return;
+    }
+    while (true) {
+        uint32_t seen = bell_count(&channel->bell);
+        if (read_frames(framer) > 0) {
+            return;
+        }
+        if (bell_wait(&channel->bell, seen, thisPlayer->spins,
+                HUB_TIMEOUT) == BELL_TIMEOUT && hub_gone()) {
+            framer->eof = true;
+            return;
+        }
+    }
+}
+
+/*
+ * Reads the next binary record from framer, pointing message at its text
+ * form in text (for the From hub: echo) and record at the record itself.
+ * Returns the length of the text, or FRAME_EOF.
+ */
+int next_binary(Framer *framer, ThisPlayer *thisPlayer, char *text,
+        char **message, char **record) {
+    int type;
+    int length;
+
+    while ((type = peek_byte(framer)) == FRAME_WAIT) {
+        read_hub(framer, thisPlayer);
+    }
+    if (type == FRAME_EOF) {
+        return FRAME_EOF;
+    }
+    if (wire_size(type) == 0) {
         exit_with(MESSAGE_EXIT);
     }
-    
-    //parse message
-    if (strcmp(token, "newround") == 0) {
-        // add card to hand, pass true as it is a new round
-        add_card(secondArg[0], true, thisPlayer, players);
-    } else if (strcmp(token, "yourturn") == 0) {
-        // add card (c) and make a move
-        add_card(secondArg[0], false, thisPlayer, players);
-        print_status(players, thisPlayer); //print second status info
-        make_move(players, thisPlayer);
-    } else if (strcmp(token, "thishappened") == 0) {
-        //update state of other players
-        update_state(secondArg, thisPlayer, players);
-    } else if (strcmp(token, "replace") == 0) {
-        if (secondArg[0] < '1' || secondArg[0] > '8' || 
-                strlen(keepCopy) != 9) {
-            exit_with(MESSAGE_EXIT);
-        } 
-        //replace card we are holding
-        thisPlayer->cards[FIRST] = secondArg[FIRST]; 
-    } else if (strcmp(token, "scores") == 0) {
-        //check the score message
-        check_score_message(keepCopy, thisPlayer->numberOthers);
-    } else {
-        //it was none of the above, exit with message error
+    while ((length = next_record(framer, wire_size(type), record)) ==
+            FRAME_WAIT) {
+        read_hub(framer, thisPlayer);
+    }
+    if (length == FRAME_EOF) {
         exit_with(MESSAGE_EXIT);
     }
+    format_record((unsigned char*)*record, thisPlayer->numberOthers, text);
+    *message = text;
+    return strlen(text);
 }
 
 /*
  * Runs a game by continuously reading in from stdin and processing
- * the message. Exits program on reception of 'gameover\n' or EOF.
+ * the message. Exits program on reception of 'gameover\n' or EOF, and
+ * starts over on reception of 'newgame\n'.
  */
 void run_game(Player *players, ThisPlayer *thisPlayer) {
     /*variable declarations*/
     bool gameover = false; //gameover boolean
-    char input[23], c, *message; //generic char c, *in is message in
-    int readIn; //counts number of chars read in from stdin
+    Framer *framer = malloc(sizeof(Framer)); //reads messages from stdin
+    char *message; //the message in, where it was read
+    int length; //the length of the message, or why there isn't one
+    char *record = NULL; //the binary record, if the hub sends them
+    char text[WIRE_MAX_TEXT + 1]; //the text form of a binary record
+    char decoded[9]; //the argument of a binary record
+    char *argument; //the argument of the message, after its word
+    int type; //which message it was, or 0 for none
    
+    init_framer(framer, STDIN_FILENO);
+    if (thisPlayer->channel != NULL) {
+        framer->ring = &thisPlayer->channel->toPlayer;
+    }
     while (gameover == false) {
-        readIn = 0; //reset input array and readIn
-        for (int j = 0; j < 23; j++) {
-            input[j] = 0;
-        }
-        c = fgetc(stdin); //get first char
-
-        //get input
-        while(c != '\n' && c != EOF) {
-            input[readIn++] = c;
-            // if i >= 22 and no \n then bad message
-            if (readIn == 22) {
-                input[--readIn] = '\0';
-                fprintf(stderr, "From hub:%s\n", input);
-                print_status(players, thisPlayer);
-                exit_with(MESSAGE_EXIT);
+        //get input, reading more until a whole message is in
+        if (thisPlayer->binary) {
+            length = next_binary(framer, thisPlayer, text, &message,
+                    &record);
+        } else {
+            while ((length = next_frame(framer, MAX_MESSAGE, &message)) ==
+                    FRAME_WAIT) {
+                read_hub(framer, thisPlayer);
             }
-            c = fgetc(stdin);
         }
- 
+        // if there are 22 chars and no \n then bad message
+        if (length == FRAME_TOO_LONG) {
+            report_from_hub(message, MAX_MESSAGE);
+            print_status(players, thisPlayer);
+            exit_with(MESSAGE_EXIT);
+        }
         //check for EOF
-        if (c == EOF) {
+        if (length == FRAME_EOF) {
             exit_with(HUB_EXIT);
         }
         
         //send from hub message
-        fprintf(stderr, "From hub:%s\n", input);
-        message = input;
+        report_from_hub(message, strlen(message));
    
         //print the first set of status information
         print_status(players, thisPlayer);
+        //parse the given message
+        if (thisPlayer->binary) {
+            type = parse_record((unsigned char*)record,
+                    thisPlayer->numberOthers, decoded);
+            argument = decoded;
+        } else {
+            type = parse_message(message, length,
+                    thisPlayer->numberOthers, &argument);
+        }
         //check if it was gameover message
-        if (strcmp(message, "gameover") == 0) {
+        if (type == WIRE_GAMEOVER) {
             gameover = true;
             exit_with(NORMAL_EXIT);
         }
+        //check if another game is starting
+        if (type == WIRE_NEWGAME) {
+            new_game(players, thisPlayer);
+            print_status(players, thisPlayer);
+            continue;
+        }
    
-        //parse the given message
-        parse_message(players, thisPlayer, message);
+        handle_message(players, thisPlayer, type, argument);
         //print status information
         print_status(players, thisPlayer);
     }
 }
 
+/*
+ * Attaches thisPlayer to the shared memory channel the hub offered (if
+ * any), so that the hub sees it has before the handshake. Stays on the
+ * pipes if the offer makes no sense.
+ */
+void attach_channel(ThisPlayer *thisPlayer) {
+    char *offer = getenv(SHM_ENV);
+    int fd, index, spins;
+    SharedRegion *region;
+
+    thisPlayer->channel = NULL;
+    if (offer == NULL || sscanf(offer, "%d %d %d", &fd, &index,
+            &spins) != 3) {
+        return;
+    }
+    region = map_region(fd);
+    close(fd);
+    if (region == NULL || index < 0 || index >= region->numChannels) {
+        return;
+    }
+    thisPlayer->channel = &region->channels[index];
+    thisPlayer->hubBell = &region->bell;
+    thisPlayer->spins = spins;
+    __atomic_store_n(&thisPlayer->channel->attached, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Writes out the trace ring when asked to with SIGUSR1. The ring only
+ * ever holds whole records, so it can be flushed between any two
+ * instructions of the player.
+ */
+void flush_on_request(int signal) {
+    flush_trace(trace);
+}
+
+/*
+ * Writes out the trace ring as the player dies from signal, then dies
+ * from it anyway.
+ */
+void flush_on_crash(int signal) {
+    flush_trace(trace);
+    raise(signal);
+}
+
+/*
+ * Works out where the status lines of player label go: into a trace
+ * ring if TRACE_ENV names where to flush one, nowhere if stderr is
+ * /dev/null (as it is under the hub), or else to stderr as always.
+ */
+void start_reporting(char label, int numberPlayers) {
+    char *prefix = getenv(TRACE_ENV);
+    struct stat err, null;
+
+    if (prefix != NULL && prefix[0] != '\0') {
+        trace = malloc(sizeof(Trace));
+        init_trace(trace, prefix, label, numberPlayers);
+        reporting = REPORT_TRACE;
+
+        struct sigaction flushHandler;
+        memset(&flushHandler, 0, sizeof(flushHandler));
+        sigemptyset(&flushHandler.sa_mask);
+        flushHandler.sa_handler = flush_on_request;
+        flushHandler.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &flushHandler, 0);
+        //the default action is restored before the handler runs
+        flushHandler.sa_handler = flush_on_crash;
+        flushHandler.sa_flags = SA_RESETHAND;
+        sigaction(SIGSEGV, &flushHandler, 0);
+        sigaction(SIGBUS, &flushHandler, 0);
+        sigaction(SIGABRT, &flushHandler, 0);
+        sigaction(SIGTERM, &flushHandler, 0);
+    } else if (fstat(STDERR_FILENO, &err) == 0 &&
+            stat("/dev/null", &null) == 0 && S_ISCHR(err.st_mode) &&
+            err.st_rdev == null.st_rdev) {
+        reporting = REPORT_NONE;
+    }
+}
+
 /*
  * The main function
  */ 
 int main(int argc, char **argv) {
-    // on startup print single '-' to stdout
-    fprintf(stdout, "-");
+    // create thisPlayer struct, on the shared memory if offered
+    ThisPlayer *thisPlayer = malloc(sizeof(ThisPlayer));
+    attach_channel(thisPlayer);
+
+    // on startup print single '-' to stdout, or '+' to take up the
+    // binary protocol if the hub offered it
+    char *wire = getenv(WIRE_ENV);
+    bool binary = wire != NULL && strcmp(wire, "binary") == 0;
+    fprintf(stdout, "%c", binary ? WIRE_BINARY : WIRE_TEXT);
     fflush(stdout);
 
     //generate signal handler to ignore SIGPIPE
@@ -688,11 +1111,19 @@ int main(int argc, char **argv) {
         exit_with(ID_EXIT);
     }
     
-    // create thisPlayer struct
-    ThisPlayer *thisPlayer = malloc(sizeof(ThisPlayer*));
+    // fill in thisPlayer
     thisPlayer->label = label;
     thisPlayer->numberOthers = numberPlayers;
     thisPlayer->addNext = 1;
+    thisPlayer->binary = binary;
+    reset_belief(&thisPlayer->belief, numberPlayers, label);
+    start_reporting(label, numberPlayers);
+
+    //play by a strategy if one is named, else by make_move
+    char *name = getenv(STRATEGY_ENV);
+    thisPlayer->strategy = name == NULL ? NULL : find_strategy(name);
+    thisPlayer->state = thisPlayer->strategy == NULL ? NULL :
+            thisPlayer->strategy->create(numberPlayers, label);
     
     //create an array of player structs for the other players
     Player *players = malloc(numberPlayers * sizeof(Player));
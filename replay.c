@@ -0,0 +1,252 @@
+/*
+ * The replay program
+ *
+ * Reads an event log written by hub -l (see gamelog.h) and either prints
+ * the commentary the hub printed for it, or with -v plays every game
+ * over through the rules engine to check it went as logged.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "loveletter.h"
+#include "gamelog.h"
+
+/*Error exit statuses*/
+#define NORMAL_EXIT 0
+#define USAGE_ERROR 1
+#define ACCESS_ERROR 2
+#define LOG_ERROR 3
+#define RULES_ERROR 4
+
+/* A table of the logged hub, being played over
+ * - numPlayers: the number of players in its game, or 0 before the first
+ * - game: the game being played
+ * - deck: a deck to start games with, as the log gives each round's
+ * - corpus: the one deck as a corpus, for the engine
+ */
+typedef struct Table {
+    int numPlayers;
+    Game game;
+    Deck deck;
+    DeckCorpus corpus;
+} Table;
+
+/* Where the replay is up to
+ * - tables: one per table of the hub (when verifying)
+ * - numTables: the number of tables
+ * - commentary: the commentary being told (when not verifying)
+ * - verify: true to check games rather than print them
+ * - records: the number of records read
+ * - games: the number of games finished
+ * - moves: the number of moves made
+ */
+typedef struct Replay {
+    Table* tables;
+    int numTables;
+    Commentary commentary;
+    bool verify;
+    long records;
+    long games;
+    long moves;
+} Replay;
+
+/*
+ * Exits the process with the given exitStatus.
+ */
+void exit_with(int exitStatus) {
+    switch(exitStatus) {
+        case 1:
+            fprintf(stderr, "Usage: replay [-v] logfile\n");
+            break;
+        case 2:
+            fprintf(stderr, "Unable to access logfile\n");
+            break;
+        case 3:
+            fprintf(stderr, "Error reading log\n");
+            break;
+        default:
+            break;
+    }
+    exit(exitStatus);
+}
+
+/*
+ * Exits with RULES_ERROR, saying which record of replay the logged game
+ * and the rules engine disagree at.
+ */
+void disagree(const Replay* replay, const char* what) {
+    fprintf(stderr, "Record %ld does not follow the rules: %s\n",
+            replay->records, what);
+    exit(RULES_ERROR);
+}
+
+/*
+ * Checks a move record against the engine, applying it to the game of
+ * its table.
+ */
+void verify_move(Replay* replay, Table* table, const LogRecord* record) {
+    Game* game = &table->game;
+    const char* logged = record->data + LOG_MOVE_EVENT;
+    Outcome outcome;
+
+    if (next_turn(game) != record->seat) {
+        disagree(replay, "not their turn");
+    }
+    if (apply_move(game, record->seat, record->data + LOG_MOVE_SENT,
+            &outcome) != MOVE_OK) {
+        disagree(replay, "invalid move");
+    }
+    const Event* event = &outcome.event;
+    char applied[LOG_MOVE_SHOWN - LOG_MOVE_EVENT] = {event->player,
+            event->card, event->target, event->guess, event->dropper,
+            event->dropped, event->eliminated};
+    if (memcmp(applied, logged, sizeof(applied)) != 0 ||
+            shown_dropped(game, event) != record->data[LOG_MOVE_SHOWN]) {
+        disagree(replay, "different outcome");
+    }
+}
+
+/*
+ * Checks a scores record against the engine, finishing the round of
+ * its table.
+ */
+void verify_scores(Replay* replay, Table* table, const LogRecord* record) {
+    Game* game = &table->game;
+    int winners;
+
+    if (next_turn(game) >= 0) {
+        disagree(replay, "round not over");
+    }
+    finish_round(game);
+    char high = find_round_winners(game, &winners);
+    if (high != record->data[LOG_SCORES_HIGH] ||
+            winners != record->data[LOG_SCORES_WINNERS]) {
+        disagree(replay, "different round winners");
+    }
+    for (int i = 0; i < game->numPlayers; i++) {
+        if (game->scores[i] != record->data[LOG_SCORES_SCORES + i]) {
+            disagree(replay, "different scores");
+        }
+    }
+}
+
+/*
+ * Checks record against the rules engine, playing it on the game of its
+ * table.
+ */
+void verify_record(Replay* replay, Table* table, const LogRecord* record) {
+    Game* game = &table->game;
+
+    switch (record->type) {
+        case LOG_GAME:
+            //a round's deck comes with its round
+            table->corpus.decks = &table->deck;
+            table->corpus.numDecks = 1;
+            init_game(game, table->numPlayers, &table->corpus, 0);
+            break;
+        case LOG_ROUND:
+            memcpy(table->deck.cards, record->data, DECK_SIZE);
+            if (!check_sum(table->deck.cards)) {
+                disagree(replay, "bad deck");
+            }
+            start_round(game);
+            break;
+        case LOG_MOVE:
+            verify_move(replay, table, record);
+            break;
+        case LOG_SCORES:
+            verify_scores(replay, table, record);
+            break;
+        case LOG_WINNER:
+            if (!is_winner(game)) {
+                disagree(replay, "no winner");
+            }
+            break;
+    }
+    //every record is logged with the rounds finished after it
+    if (game->round != record->round) {
+        disagree(replay, "wrong round");
+    }
+}
+
+/*
+ * Replays every record of log.
+ */
+void replay_log(Replay* replay, FILE* log) {
+    LogRecord record;
+
+    while (read_log(log, &record)) {
+        replay->records++;
+        if (record.type == LOG_MOVE) {
+            replay->moves++;
+        } else if (record.type == LOG_WINNER) {
+            replay->games++;
+        }
+        if (!replay->verify) {
+            if (!comment_record(&replay->commentary, &record)) {
+                exit_with(LOG_ERROR);
+            }
+            continue;
+        }
+        if (record.table >= replay->numTables || (record.type !=
+                LOG_GAME && replay->tables[record.table].numPlayers == 0)) {
+            exit_with(LOG_ERROR);
+        }
+        Table* table = &replay->tables[record.table];
+        if (record.type == LOG_GAME) {
+            table->numPlayers = record.data[0];
+            if (table->numPlayers < MIN_PLAYERS ||
+                    table->numPlayers > MAX_PLAYERS) {
+                exit_with(LOG_ERROR);
+            }
+        }
+        verify_record(replay, table, &record);
+    }
+}
+
+/*
+ * The main function
+ */
+int main(int argc, char** argv) {
+    Replay replay;
+    int opt;
+
+    memset(&replay, 0, sizeof(Replay));
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+            case 'v':
+                replay.verify = true;
+                break;
+            default:
+                exit_with(USAGE_ERROR);
+        }
+    }
+    if (argc - optind != 1) {
+        exit_with(USAGE_ERROR);
+    }
+    FILE* log = fopen(argv[optind], "r");
+    if (log == NULL) {
+        exit_with(ACCESS_ERROR);
+    }
+    if (!read_log_header(log, &replay.numTables) ||
+            replay.numTables < 1) {
+        exit_with(LOG_ERROR);
+    }
+
+    if (replay.verify) {
+        replay.tables = calloc(replay.numTables, sizeof(Table));
+    } else {
+        init_commentary(&replay.commentary, stdout, replay.numTables);
+    }
+    replay_log(&replay, log);
+    fclose(log);
+    if (replay.verify) {
+        fprintf(stdout, "games %ld\n", replay.games);
+        fprintf(stdout, "moves %ld\n", replay.moves);
+        fprintf(stdout, "verified\n");
+    }
+    return NORMAL_EXIT;
+}
@@ -0,0 +1,188 @@
+/*
+ * The shared memory transport (libloveletter)
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shm.h"
+
+/*
+ * Lets a sibling hyperthread run while spinning.
+ */
+static void relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*
+ * Makes a memfd big enough for numChannels channels and maps it, storing
+ * the fd (closed on exec) in fd. Returns NULL if it cannot be made.
+ */
+SharedRegion* create_region(int numChannels, int* fd) {
+    size_t size = sizeof(SharedRegion) + sizeof(Channel) * numChannels;
+    SharedRegion* region;
+
+    *fd = memfd_create("loveletter", MFD_CLOEXEC);
+    if (*fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(*fd, size) != 0) {
+        close(*fd);
+        return NULL;
+    }
+    region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    if (region == MAP_FAILED) {
+        close(*fd);
+        return NULL;
+    }
+    //a new memfd is all zeros, which is every ring empty
+    region->numChannels = numChannels;
+    return region;
+}
+
+/*
+ * Maps the region made by create_region in another process. Returns
+ * NULL if fd is not such a region.
+ */
+SharedRegion* map_region(int fd) {
+    struct stat info;
+    SharedRegion* region;
+
+    if (fstat(fd, &info) != 0 || info.st_size < sizeof(SharedRegion)) {
+        return NULL;
+    }
+    region = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    if (sizeof(SharedRegion) + sizeof(Channel) *
+            (size_t)region->numChannels != info.st_size) {
+        munmap(region, info.st_size);
+        return NULL;
+    }
+    return region;
+}
+
+/*
+ * Takes up to size waiting bytes out of ring into buffer, without
+ * blocking. Returns the number taken (0 if the ring is empty).
+ */
+int ring_read(Ring* ring, char* buffer, int size) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t count = head - tail;
+    uint32_t offset = tail % RING_SIZE;
+
+    if (count > size) {
+        count = size;
+    }
+    //the bytes may wrap around the end of data
+    uint32_t first = count < RING_SIZE - offset ? count : RING_SIZE - offset;
+    memcpy(buffer, ring->data + offset, first);
+    memcpy(buffer + first, ring->data, count - first);
+    __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+/*
+ * Returns true if ring has nothing waiting to be read.
+ */
+bool ring_empty(Ring* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+}
+
+/*
+ * Puts the bytes of parts into ring, in order, then rings bell once.
+ * Waits for the reader if the ring is full. Returns true if a syscall
+ * was needed to wake the reader.
+ */
+bool ring_write(Ring* ring, Bell* bell, const struct iovec* parts,
+        int numParts) {
+    uint32_t head = ring->head;
+
+    for (int i = 0; i < numParts; i++) {
+        const char* data = parts[i].iov_base;
+        uint32_t left = parts[i].iov_len;
+
+        while (left > 0) {
+            uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            uint32_t space = RING_SIZE - (head - tail);
+            uint32_t offset = head % RING_SIZE;
+            uint32_t count = left < space ? left : space;
+
+            if (count == 0) {
+                //let the reader catch up with what is there so far
+                __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+                bell_ring(bell);
+                sched_yield();
+                continue;
+            }
+            if (count > RING_SIZE - offset) {
+                count = RING_SIZE - offset;
+            }
+            memcpy(ring->data + offset, data, count);
+            head += count;
+            data += count;
+            left -= count;
+        }
+    }
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    return bell_ring(bell);
+}
+
+/*
+ * Returns how many times bell has been rung. A reader takes this before
+ * looking for bytes, and waits with it if there were none.
+ */
+uint32_t bell_count(Bell* bell) {
+    return __atomic_load_n(&bell->count, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Rings bell, waking its reader if it is asleep. Returns true if that
+ * needed a syscall.
+ */
+bool bell_ring(Bell* bell) {
+    __atomic_fetch_add(&bell->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&bell->waiting, __ATOMIC_SEQ_CST)) {
+        syscall(SYS_futex, &bell->count, FUTEX_WAKE, INT_MAX, NULL, NULL,
+                0);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Waits for bell to be rung after it read seen: spins up to spins times,
+ * then sleeps for at most timeout milliseconds. Returns BELL_SPUN if it
+ * never slept, BELL_WOKEN if it slept and was rung, or BELL_TIMEOUT.
+ */
+int bell_wait(Bell* bell, uint32_t seen, int spins, int timeout) {
+    struct timespec wait = {timeout / 1000, (timeout % 1000) * 1000000L};
+
+    for (int i = 0; i < spins; i++) {
+        if (__atomic_load_n(&bell->count, __ATOMIC_ACQUIRE) != seen) {
+            return BELL_SPUN;
+        }
+        relax();
+    }
+    //the writer checks waiting after ringing, so one of us sees the other
+    int result = BELL_SPUN;
+    __atomic_store_n(&bell->waiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&bell->count, __ATOMIC_SEQ_CST) == seen) {
+        syscall(SYS_futex, &bell->count, FUTEX_WAIT, seen, &wait, NULL, 0);
+        result = BELL_WOKEN;
+    }
+    __atomic_store_n(&bell->waiting, 0, __ATOMIC_SEQ_CST);
+    return bell_count(bell) != seen ? result : BELL_TIMEOUT;
+}
@@ -0,0 +1,93 @@
+/*
+ * The shared memory transport (libloveletter)
+ *
+ * An opt-in alternative to pipes for carrying protocol messages. The hub
+ * makes one memfd holding a Channel per player and passes it across exec,
+ * naming the fd, the player's channel and how long to busy-poll in
+ * SHM_ENV. Each Channel holds a single producer, single consumer ring
+ * each way. A waiting reader spins for a while and then sleeps on a
+ * futex Bell, which the writer only has to wake if someone is asleep.
+ * The player's own Bell rings for messages from the hub; every player
+ * rings the hub's one Bell, so the hub can sleep on all of them at once.
+ *
+ * The handshake still goes over the pipes, and a player that attached to
+ * its channel says so before sending it. The pipes stay open, so either
+ * side can still tell when the other has gone.
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/* The environment variable a hub uses to offer shared memory, holding
+ * "fd channel spins" */
+#define SHM_ENV "LOVELETTER_SHM"
+/* Bytes in each ring (a power of 2) */
+#define RING_SIZE 4096
+/* Keep the fields written by different processes on their own lines */
+#define SHM_LINE 64
+/* Results of bell_wait: rung without sleeping, rung while asleep, or
+ * never rung */
+#define BELL_SPUN 0
+#define BELL_WOKEN 1
+#define BELL_TIMEOUT 2
+
+/* A futex a reader sleeps on
+ * - count: rung once for every write
+ * - waiting: true while the reader is asleep (or about to be)
+ */
+typedef struct Bell {
+    uint32_t count;
+    uint32_t waiting;
+} __attribute__((aligned(SHM_LINE))) Bell;
+
+/* A single producer, single consumer byte ring. head and tail count
+ * every byte ever written and read, so head - tail bytes are waiting.
+ * - head: written by the producer only
+ * - tail: written by the consumer only
+ * - data: the bytes, byte n at data[n % RING_SIZE]
+ */
+typedef struct Ring {
+    uint32_t head __attribute__((aligned(SHM_LINE)));
+    uint32_t tail __attribute__((aligned(SHM_LINE)));
+    char data[RING_SIZE] __attribute__((aligned(SHM_LINE)));
+} Ring;
+
+/* The shared memory of one player
+ * - bell: rung by the hub when it writes to toPlayer
+ * - attached: set by the player once it is reading from the channel
+ * - toPlayer: messages from the hub
+ * - toHub: replies from the player
+ */
+typedef struct Channel {
+    Bell bell;
+    uint32_t attached;
+    Ring toPlayer;
+    Ring toHub;
+} Channel;
+
+/* The whole memfd
+ * - bell: rung by every player when it writes to its toHub
+ * - numChannels: the number of channels
+ * - channels: one per player of every table
+ */
+typedef struct SharedRegion {
+    Bell bell;
+    int numChannels;
+    Channel channels[];
+} SharedRegion;
+
+SharedRegion* create_region(int numChannels, int* fd);
+SharedRegion* map_region(int fd);
+int ring_read(Ring* ring, char* buffer, int size);
+bool ring_empty(Ring* ring);
+bool ring_write(Ring* ring, Bell* bell, const struct iovec* parts,
+        int numParts);
+uint32_t bell_count(Bell* bell);
+bool bell_ring(Bell* bell);
+int bell_wait(Bell* bell, uint32_t seen, int spins, int timeout);
+
+#endif
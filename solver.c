@@ -0,0 +1,232 @@
+/*
+ * Perfect information round solver (libloveletter)
+ *
+ * A position is the round between turns, once the next card has been
+ * dealt. With the deck known, everything else follows from 31 bits:
+ * the deck position (5 bits), the seat to move (2), each seat's card (4
+ * each) and each seat's out and protected bits (4 each). A table entry
+ * is one 64 bit word: the position, the result (the seats that win and
+ * the turns left, 4 bits each) and a tag naming the solve it came from,
+ * so entries from other decks never match. Threads load and store whole
+ * words atomically, so none ever sees half of another's entry, and a
+ * lost race only costs a position being searched twice.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "solver.h"
+
+/* The bits of an entry: position, result, tag */
+#define POSITION_BITS 31
+#define RESULT_BITS 8
+#define TAG_BITS (64 - POSITION_BITS - RESULT_BITS)
+#define POSITION_MASK ((1ULL << POSITION_BITS) - 1)
+#define RESULT_MASK ((1ULL << RESULT_BITS) - 1)
+#define TAG_MASK ((1ULL << TAG_BITS) - 1)
+/* Where the fields of a position start */
+#define SEAT_SHIFT 5
+#define HOLDING_SHIFT 7
+#define OUT_SHIFT 23
+#define PROTECTED_SHIFT 27
+/* A result holds the winners in its low 4 bits and the turns above */
+#define TURNS_SHIFT 4
+#define WINNERS_MASK 0xf
+
+/* A transposition table
+ * - table: the entries, 0 where empty
+ * - tableBits: log2 of the number of entries
+ * - solves: the rounds solved so far, which tags are taken from
+ */
+struct Solver {
+    uint64_t* table;
+    int tableBits;
+    uint64_t solves;
+};
+
+/* One round being solved
+ * - solver: the solver with the table
+ * - tag: the tag of this round's entries
+ */
+typedef struct Search {
+    Solver* solver;
+    uint64_t tag;
+} Search;
+
+/*
+ * Returns a solver with a table of 2 to the tableBits entries, or NULL if
+ * there is not the memory for it.
+ */
+Solver* create_solver(int tableBits) {
+    Solver* solver = calloc(1, sizeof(Solver));
+
+    solver->tableBits = tableBits;
+    solver->table = calloc(1UL << tableBits, sizeof(uint64_t));
+    if (solver->table == NULL) {
+        free(solver);
+        return NULL;
+    }
+    return solver;
+}
+
+/*
+ * Frees a solver made by create_solver.
+ */
+void free_solver(Solver* solver) {
+    free(solver->table);
+    free(solver);
+}
+
+/*
+ * Returns the position of game, just dealt to seat.
+ */
+static uint64_t pack_position(const Game* game, int seat) {
+    uint64_t position = game->pos | seat << SEAT_SHIFT;
+
+    for (int i = 0; i < game->numPlayers; i++) {
+        const Player* player = &game->players[i];
+        position |= (uint64_t)(player->holding - '0') <<
+                (HOLDING_SHIFT + 4 * i);
+        position |= (uint64_t)player->outOfRound << (OUT_SHIFT + i);
+        position |= (uint64_t)player->protected << (PROTECTED_SHIFT + i);
+    }
+    return position;
+}
+
+static int search_position(Search* search, const Game* game);
+
+/*
+ * Tries the moves of seat, just dealt a card in game, and returns the
+ * result of the one it would play (see solver.h). A card with no effect
+ * on others is only tried with no target, and a 1 guesses only the
+ * target's card (or, as any miss does, nothing).
+ */
+static int best_move(Search* search, const Game* game, int seat) {
+    char cards[2] = {game->players[seat].holding, game->given};
+    Outcome outcome;
+    int best = -1;
+
+    for (int c = 0; c < 2 && (c == 0 || cards[1] != cards[0]); c++) {
+        bool aims = cards[c] == '1' || cards[c] == '3' || cards[c] == '5' ||
+                cards[c] == '6';
+        for (int t = -1; t < (aims ? game->numPlayers : 0); t++) {
+            char guesses[2] = {'-', '-'};
+            int numGuesses = 1;
+            if (cards[c] == '1' && t >= 0 &&
+                    game->players[t].holding != '1') {
+                guesses[0] = game->players[t].holding;
+                numGuesses = 2;
+            }
+            for (int g = 0; g < numGuesses; g++) {
+                char move[3] = {cards[c], t < 0 ? '-' : t + SHIFT,
+                        guesses[g]};
+                Game next = *game;
+                if (apply_move(&next, seat, move, &outcome) != MOVE_OK) {
+                    continue;
+                }
+                int result = search_position(search, &next) +
+                        (1 << TURNS_SHIFT);
+                if (result & (1 << seat)) {
+                    return result;
+                }
+                if (best < 0) {
+                    best = result;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Returns the result of game, before the next card is dealt: the seats
+ * that win the round, and the turns left above TURNS_SHIFT.
+ */
+static int search_position(Search* search, const Game* game) {
+    int winners = 0;
+
+    if (game->roundOver) {
+        //scoring has put everyone but the winners out
+        for (int i = 0; i < game->numPlayers; i++) {
+            if (!game->players[i].outOfRound) {
+                winners |= 1 << i;
+            }
+        }
+        return winners;
+    }
+    Game dealt = *game;
+    int seat = next_turn(&dealt);
+    if (seat < 0) {
+        return winners;
+    }
+    uint64_t position = pack_position(&dealt, seat);
+    Solver* solver = search->solver;
+    uint64_t* slot = &solver->table[((position ^ search->tag <<
+            POSITION_BITS) * GOLDEN) >> (64 - solver->tableBits)];
+    uint64_t entry = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    if ((entry & POSITION_MASK) == position &&
+            entry >> (POSITION_BITS + RESULT_BITS) == search->tag) {
+        return (entry >> POSITION_BITS) & RESULT_MASK;
+    }
+    int result = best_move(search, &dealt, seat);
+    __atomic_store_n(slot, position | (uint64_t)result << POSITION_BITS |
+            search->tag << (POSITION_BITS + RESULT_BITS), __ATOMIC_RELAXED);
+    return result;
+}
+
+/*
+ * Solves the first round of a game of numPlayers players on deck with
+ * solver (see solver.h). Returns the seats that win it, as a mask with
+ * bit i set for seat i, and sets turns to the turns it takes.
+ */
+int solve_round(Solver* solver, const Deck* deck, int numPlayers,
+        int* turns) {
+    Deck copy = *deck;
+    DeckCorpus corpus;
+    Search search;
+    Game game;
+
+    memset(&corpus, 0, sizeof(DeckCorpus));
+    corpus.decks = &copy;
+    corpus.numDecks = 1;
+    //tags run from 1, so an empty entry never matches
+    search.solver = solver;
+    search.tag = __atomic_fetch_add(&solver->solves, 1, __ATOMIC_RELAXED) %
+            TAG_MASK + 1;
+    init_game(&game, numPlayers, &corpus, 0);
+    start_round(&game);
+    int result = search_position(&search, &game);
+    *turns = result >> TURNS_SHIFT;
+    return result & WINNERS_MASK;
+}
+
+/*
+ * Solves the first round of a game of numPlayers players on each of
+ * numDecks decks of corpus in turn, from deck firstDeck, and adds how
+ * each went to stats as simulate_rounds does. Returns MOVE_OK, or
+ * MOVE_NO_DECK as soon as the decks run out.
+ */
+int solve_rounds(Solver* solver, const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numDecks, RoundStats* stats) {
+    Deck deck;
+    int turns;
+
+    for (long d = 0; d < numDecks; d++) {
+        if (!get_deck(corpus, firstDeck, &deck)) {
+            return MOVE_NO_DECK;
+        }
+        int winners = solve_round(solver, &deck, numPlayers, &turns);
+        for (int i = 0; i < numPlayers; i++) {
+            if (winners & (1 << i)) {
+                stats->points[i]++;
+            }
+        }
+        stats->rounds++;
+        stats->turns += turns;
+        stats->winners[winners]++;
+        stats->lengths[turns]++;
+        if (++firstDeck == corpus->numDecks) {
+            firstDeck = 0;
+        }
+    }
+    return MOVE_OK;
+}
@@ -0,0 +1,35 @@
+/*
+ * Perfect information round solver (libloveletter)
+ *
+ * solve_round works out how the first round of a game on a deck goes if
+ * every seat knows the whole deck and plays for its own point: each seat
+ * plays the first of its moves (in the order the solver tries them) that
+ * wins it the round, or its first move if none does. The moves tried are
+ * every move apply_move accepts, less those that only repeat another
+ * one, and they are played by the engine itself, so the result is
+ * exactly what the hub would have scored.
+ *
+ * Positions are remembered in a transposition table that any number of
+ * threads solving at once share without locks.
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "loveletter.h"
+
+/* log2 of the entries in a solver's table, unless asked otherwise */
+#define SOLVER_TABLE_BITS 22
+
+/* A transposition table and the count of rounds solved with it (see
+ * solver.c) */
+typedef struct Solver Solver;
+
+Solver* create_solver(int tableBits);
+void free_solver(Solver* solver);
+int solve_round(Solver* solver, const Deck* deck, int numPlayers,
+        int* turns);
+int solve_rounds(Solver* solver, const DeckCorpus* corpus, long firstDeck,
+        int numPlayers, long numDecks, RoundStats* stats);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * The strategy interface (libloveletter)
+ *
+ * What an in-process player sees of a game: the hub's messages as
+ * callbacks, with no access to the engine. The hub, the tournament and
+ * the player program all play seats through it.
+ */
+
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+/* What a thishappened message reports, all as protocol chars:
+ * - player: player who made move
+ * - card: played card
+ * - target: the targeted player
+ * - guess: the card being guessed
+ * - dropper: the player dropping their card
+ * - dropped: the dropped card
+ * - eliminated: the eliminated player
+ */
+typedef struct Event {
+    char player;
+    char card;
+    char target;
+    char guess;
+    char dropper;
+    char dropped;
+    char eliminated;
+} Event;
+
+/* Strategy plugins: a shared object exporting
+ *     const Strategy* loveletter_strategy(int abi);
+ * which returns its Strategy, or NULL if abi is not the STRATEGY_ABI it
+ * was built with. find_strategy loads one for a name of the form
+ * lib:path. */
+#define STRATEGY_ABI 1
+#define STRATEGY_SYMBOL "loveletter_strategy"
+#define STRATEGY_PREFIX "lib:"
+/* The player program plays by the strategy named in STRATEGY_ENV (as
+ * find_strategy takes it), or by its own rules if it is unset or names
+ * none */
+#define STRATEGY_ENV "LOVELETTER_STRATEGY"
+/* The ismcts strategy searches for ISMCTS_BUDGET_ENV microseconds a move
+ * (ISMCTS_BUDGET if unset), on ISMCTS_THREADS_ENV threads (one per core
+ * if unset) */
+#define ISMCTS_BUDGET_ENV "LOVELETTER_BUDGET"
+#define ISMCTS_THREADS_ENV "LOVELETTER_THREADS"
+#define ISMCTS_BUDGET 1000
+
+/* An in-process player. Every callback mirrors a hub message; state is
+ * whatever create returned for the seat.
+ * - create: make the state for a seat (label 'A' onwards)
+ * - destroy: release the state (may be NULL)
+ * - on_newround: newround c
+ * - on_yourturn: yourturn c, writes the 3 char reply into move
+ * - on_thishappened: thishappened pcpc/pcp
+ * - on_replace: replace c
+ * - on_scores: scores i j...
+ */
+typedef struct Strategy {
+    void* (*create)(int numPlayers, char label);
+    void (*destroy)(void* state);
+    void (*on_newround)(void* state, char card);
+    void (*on_yourturn)(void* state, char card, char move[3]);
+    void (*on_thishappened)(void* state, const Event* event);
+    void (*on_replace)(void* state, char card);
+    void (*on_scores)(void* state, const int* scores, int numPlayers);
+} Strategy;
+
+/* Bundled strategies */
+extern const Strategy basicStrategy;
+extern const Strategy ismctsStrategy;
+const Strategy* load_strategy(const char* path);
+const Strategy* find_strategy(const char* name);
+
+#endif
@@ -0,0 +1,671 @@
+/*
+ * The tournament program
+ *
+ * Plays many games between in-process strategies on every core. Game g
+ * always starts on deck g after the first deck (mod the number of
+ * decks), so results do not depend on the number of threads, and a
+ * tournament can be split into shards of games that start further on.
+ * When every seat is basic, games are played many at once by the
+ * lockstep engine, which gives the same results.
+ *
+ * With --enumerate it plays the first round of a game on every possible
+ * deck instead (or a range of them, by rank), and reports exactly how
+ * often each seat won. Workers take the decks a block at a time, and
+ * with --checkpoint each block's totals are added to a file as it is
+ * finished, so a run that stops can be picked up again with the same
+ * arguments. A checkpoint file is a line naming the run, "enumerate"
+ * then the first rank, the number of decks and the strategies, then a
+ * line per finished block: "block", its index, then its rounds, turns,
+ * points for each seat, rounds won by each set of seats and rounds of
+ * each length (as in RoundStats), separated by single spaces.
+ *
+ * With --solve players, every deck's round is solved instead (see
+ * solver.h), for that many seats that all know the deck, and reported as
+ * an enumeration is. The workers share one solver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include "loveletter.h"
+#include "solver.h"
+
+/*Error exit statuses*/
+#define NORMAL_EXIT 0
+#define USAGE_ERROR 1
+#define ACCESS_ERROR 2
+#define DECK_ERROR 3
+#define STRATEGY_ERROR 4
+#define MOVE_ERROR 5
+#define CHECKPOINT_ERROR 6
+#define MEMORY_ERROR 7
+/* Games taken from a worker's own range at a time */
+#define CHUNK 64
+/* Games taken at a time by the lockstep engine, enough to keep its lanes
+ * busy */
+#define LOCKSTEP_CHUNK 1024
+/* Keep each worker on its own cache lines */
+#define CACHE_LINE 64
+/* Codes of the options with only long names */
+#define OPTION_SEED 256
+#define OPTION_DECKS 257
+#define OPTION_ENUMERATE 258
+#define OPTION_CHECKPOINT 259
+#define OPTION_SOLVE 260
+/* Decks in each block of an enumeration */
+#define ENUMERATE_BLOCK (1L << 22)
+/* The longest line of a checkpoint file */
+#define CHECKPOINT_LINE 1024
+
+/* A worker thread and the range of games it still has to play. Other
+ * workers steal the top half of the range once their own is empty.
+ * - lock: protects next and end
+ * - next: the next game to play
+ * - end: one past the last game in the range
+ * - stats: totals for the games this worker played
+ * - rounds: totals for the blocks of decks this worker played
+ * - result: MOVE_OK, or MOVE_INVALID if a strategy made a bad move
+ * - index: the worker's index in its tournament
+ * - tournament: the tournament being played
+ * - thread: the thread running the worker
+ */
+typedef struct Worker {
+    pthread_spinlock_t lock;
+    long next;
+    long end;
+    BatchStats stats;
+    RoundStats rounds;
+    int result;
+    int index;
+    struct Tournament* tournament;
+    pthread_t thread;
+} __attribute__((aligned(CACHE_LINE))) Worker;
+
+/* A tournament
+ * - corpus: the decks, in file order
+ * - firstDeck: the deck game 0 starts on
+ * - numPlayers: the number of seats
+ * - seats: the strategy for each seat
+ * - lockstep: true to play games with simulate_lockstep (every seat is
+ *   basic)
+ * - chunk: the games a worker takes from its range at a time
+ * - workers: one per thread
+ * - numWorkers: the number of threads
+ * - byDeck: true if the workers' ranges are of blocks of decks to play
+ *   a round on each, rather than games
+ * - solver: the solver to solve the rounds with, or NULL to play them
+ * - numDecks: the decks to play a round on, from firstDeck
+ * - done: for each block, true if the checkpoint has it already
+ * - checkpoint: the checkpoint file to add finished blocks to, or NULL
+ * - checkpointLock: protects checkpoint
+ */
+typedef struct Tournament {
+    const DeckCorpus* corpus;
+    long firstDeck;
+    int numPlayers;
+    const Strategy* seats[MAX_PLAYERS];
+    bool lockstep;
+    long chunk;
+    Worker* workers;
+    int numWorkers;
+    bool byDeck;
+    Solver* solver;
+    long numDecks;
+    bool* done;
+    FILE* checkpoint;
+    pthread_mutex_t checkpointLock;
+} Tournament;
+
+/*
+ * Exits the process with the given exitStatus.
+ */
+void exit_with(int exitStatus) {
+    switch(exitStatus) {
+        case 1:
+            fprintf(stderr, "Usage: tournament [-j threads] [-n games] [-s] "
+                    "[-d deck] (deckfile | --seed seed [--decks decks] | "
+                    "--enumerate [--checkpoint file]) (strategy1 strategy2 "
+                    "[strategy3 [strategy4]] | --solve players)\n");
+            break;
+        case 2:
+            fprintf(stderr, "Unable to access deckfile\n");
+            break;
+        case 3:
+            fprintf(stderr, "Error reading deck\n");
+            break;
+        case 4:
+            fprintf(stderr, "Unknown strategy\n");
+            break;
+        case 5:
+            fprintf(stderr, "Invalid move made by strategy\n");
+            break;
+        case 6:
+            fprintf(stderr, "Unable to use checkpoint\n");
+            break;
+        case 7:
+            fprintf(stderr, "Unable to allocate memory\n");
+            break;
+        default:
+            break;
+    }
+    exit(exitStatus);
+}
+
+/*
+ * Takes the next chunk of games for worker into first and last (one
+ * past the end), from its own range. Returns false if it is empty.
+ */
+bool take_own(Worker* worker, long* first, long* last) {
+    long chunk = worker->tournament->chunk;
+    bool found = false;
+
+    pthread_spin_lock(&worker->lock);
+    if (worker->next < worker->end) {
+        *first = worker->next;
+        *last = worker->next + chunk < worker->end ?
+                worker->next + chunk : worker->end;
+        worker->next = *last;
+        found = true;
+    }
+    pthread_spin_unlock(&worker->lock);
+    return found;
+}
+
+/*
+ * Steals the top half of the remaining range of some other worker and
+ * makes it the range of the worker at index self. Returns false if no
+ * worker has games left.
+ */
+bool steal(Tournament* tournament, int self) {
+    for (int k = 1; k < tournament->numWorkers; k++) {
+        Worker* victim =
+                &tournament->workers[(self + k) % tournament->numWorkers];
+        long first = 0;
+        long last = 0;
+
+        pthread_spin_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            first = victim->next + (victim->end - victim->next) / 2;
+            last = victim->end;
+            victim->end = first;
+        }
+        pthread_spin_unlock(&victim->lock);
+        if (first < last) {
+            Worker* worker = &tournament->workers[self];
+            pthread_spin_lock(&worker->lock);
+            worker->next = first;
+            worker->end = last;
+            pthread_spin_unlock(&worker->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Writes the fields of the totals of a block to out, each after a space,
+ * as a checkpoint line has them.
+ */
+void write_block(FILE* out, const RoundStats* rounds, int numPlayers) {
+    fprintf(out, " %ld %ld", rounds->rounds, rounds->turns);
+    for (int i = 0; i < numPlayers; i++) {
+        fprintf(out, " %ld", rounds->points[i]);
+    }
+    for (int i = 0; i < 1 << numPlayers; i++) {
+        fprintf(out, " %ld", rounds->winners[i]);
+    }
+    for (int i = 0; i < DECK_SIZE; i++) {
+        fprintf(out, " %ld", rounds->lengths[i]);
+    }
+}
+
+/*
+ * Reads the fields write_block wrote from text into rounds. Returns false
+ * if they are not all there.
+ */
+bool read_block(const char* text, RoundStats* rounds, int numPlayers) {
+    long* fields[2 + MAX_PLAYERS + (1 << MAX_PLAYERS) + DECK_SIZE];
+    int numFields = 0;
+    char* end;
+
+    memset(rounds, 0, sizeof(RoundStats));
+    fields[numFields++] = &rounds->rounds;
+    fields[numFields++] = &rounds->turns;
+    for (int i = 0; i < numPlayers; i++) {
+        fields[numFields++] = &rounds->points[i];
+    }
+    for (int i = 0; i < 1 << numPlayers; i++) {
+        fields[numFields++] = &rounds->winners[i];
+    }
+    for (int i = 0; i < DECK_SIZE; i++) {
+        fields[numFields++] = &rounds->lengths[i];
+    }
+    for (int i = 0; i < numFields; i++) {
+        if (*text != ' ') {
+            return false;
+        }
+        *fields[i] = strtol(text + 1, &end, 10);
+        if (end == text + 1 || *fields[i] < 0) {
+            return false;
+        }
+        text = end;
+    }
+    return *text == '\n';
+}
+
+/*
+ * Plays (or solves) a round on every deck of block for worker, and adds
+ * the block to the checkpoint file if there is one. Returns MOVE_OK,
+ * MOVE_INVALID or MOVE_NO_DECK.
+ */
+int enumerate_block(Worker* worker, long block) {
+    Tournament* tournament = worker->tournament;
+    RoundStats rounds;
+    long first = block * ENUMERATE_BLOCK;
+    long last = first + ENUMERATE_BLOCK < tournament->numDecks ?
+            first + ENUMERATE_BLOCK : tournament->numDecks;
+
+    memset(&rounds, 0, sizeof(RoundStats));
+    long firstDeck = (tournament->firstDeck + first) %
+            tournament->corpus->numDecks;
+    int result = tournament->solver != NULL ?
+            solve_rounds(tournament->solver, tournament->corpus, firstDeck,
+            tournament->numPlayers, last - first, &rounds) :
+            simulate_rounds(tournament->corpus, firstDeck,
+            tournament->numPlayers, last - first, tournament->seats,
+            &rounds);
+    if (result != MOVE_OK) {
+        return result;
+    }
+    add_round_stats(&worker->rounds, &rounds);
+    if (tournament->checkpoint != NULL) {
+        pthread_mutex_lock(&tournament->checkpointLock);
+        fprintf(tournament->checkpoint, "block %ld", block);
+        write_block(tournament->checkpoint, &rounds, tournament->numPlayers);
+        fprintf(tournament->checkpoint, "\n");
+        fflush(tournament->checkpoint);
+        pthread_mutex_unlock(&tournament->checkpointLock);
+    }
+    return MOVE_OK;
+}
+
+/*
+ * The body of each worker thread: plays games from its own range, then
+ * from stolen ranges, until every game has been played.
+ */
+void* run_worker(void* arg) {
+    Worker* worker = arg;
+    Tournament* tournament = worker->tournament;
+    long first;
+    long last;
+
+    while (worker->result == MOVE_OK) {
+        if (!take_own(worker, &first, &last)) {
+            if (!steal(tournament, worker->index)) {
+                break;
+            }
+            continue;
+        }
+        if (tournament->byDeck) {
+            for (long b = first; b < last && worker->result == MOVE_OK;
+                    b++) {
+                if (!tournament->done[b]) {
+                    worker->result = enumerate_block(worker, b);
+                }
+            }
+            continue;
+        }
+        if (tournament->lockstep) {
+            worker->result = simulate_lockstep(tournament->corpus,
+                    (tournament->firstDeck + first) %
+                    tournament->corpus->numDecks, tournament->numPlayers,
+                    last - first, &worker->stats);
+            continue;
+        }
+        for (long g = first; g < last && worker->result == MOVE_OK; g++) {
+            worker->result = simulate_batch(tournament->corpus,
+                    (tournament->firstDeck + g) %
+                    tournament->corpus->numDecks,
+                    tournament->numPlayers, 1, tournament->seats,
+                    &worker->stats);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Plays numGames games (or blocks of an enumeration) of the tournament
+ * spread over its workers, and merges their totals into stats (or
+ * rounds). Returns MOVE_OK or MOVE_INVALID.
+ */
+int play_tournament(Tournament* tournament, long numGames,
+        BatchStats* stats, RoundStats* rounds) {
+    int result = MOVE_OK;
+    int numWorkers = tournament->numWorkers;
+
+    //give each worker an even share of the games to start with
+    void* block = NULL;
+    if (posix_memalign(&block, CACHE_LINE,
+            sizeof(Worker) * numWorkers) != 0) {
+        exit_with(MEMORY_ERROR);
+    }
+    tournament->workers = block;
+    for (int i = 0; i < numWorkers; i++) {
+        Worker* worker = &tournament->workers[i];
+        memset(worker, 0, sizeof(Worker));
+        pthread_spin_init(&worker->lock, PTHREAD_PROCESS_PRIVATE);
+        worker->next = numGames * i / numWorkers;
+        worker->end = numGames * (i + 1) / numWorkers;
+        worker->index = i;
+        worker->tournament = tournament;
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        pthread_create(&tournament->workers[i].thread, NULL, run_worker,
+                &tournament->workers[i]);
+    }
+    //wait for everyone and merge the per thread totals
+    for (int i = 0; i < numWorkers; i++) {
+        Worker* worker = &tournament->workers[i];
+        pthread_join(worker->thread, NULL);
+        pthread_spin_destroy(&worker->lock);
+        add_stats(stats, &worker->stats);
+        add_round_stats(rounds, &worker->rounds);
+        if (worker->result != MOVE_OK) {
+            result = worker->result;
+        }
+    }
+    free(tournament->workers);
+    tournament->workers = NULL;
+    return result;
+}
+
+/*
+ * Prints the results of a tournament in a stable, line per value form.
+ */
+void print_results(const Tournament* tournament, const BatchStats* stats,
+        double seconds) {
+    fprintf(stdout, "games %ld\n", stats->games);
+    fprintf(stdout, "rounds %ld\n", stats->rounds);
+    fprintf(stdout, "turns %ld\n", stats->turns);
+    for (int i = 0; i < tournament->numPlayers; i++) {
+        fprintf(stdout, "seat %c wins %ld points %ld\n", i + SHIFT,
+                stats->wins[i], stats->points[i]);
+    }
+    fprintf(stdout, "threads %d\n", tournament->numWorkers);
+    fprintf(stdout, "seconds %.3f\n", seconds);
+    fprintf(stdout, "games/sec %.0f\n",
+            seconds > 0 ? stats->games / seconds : 0.0);
+}
+
+/*
+ * Prints the results of a round on each deck in a stable, line per value
+ * form:
+ * the decks, turns and each seat's wins and share of the rounds, then
+ * the rounds won by each set of seats and the rounds of each length that
+ * any round took.
+ */
+void print_enumeration(const Tournament* tournament,
+        const RoundStats* rounds, double seconds) {
+    fprintf(stdout, "decks %ld\n", rounds->rounds);
+    fprintf(stdout, "turns %ld\n", rounds->turns);
+    for (int i = 0; i < tournament->numPlayers; i++) {
+        fprintf(stdout, "seat %c wins %ld rate %.9f\n", i + SHIFT,
+                rounds->points[i], rounds->rounds > 0 ?
+                (double)rounds->points[i] / rounds->rounds : 0.0);
+    }
+    for (int set = 1; set < 1 << tournament->numPlayers; set++) {
+        if (rounds->winners[set] == 0) {
+            continue;
+        }
+        char labels[MAX_PLAYERS + 1];
+        int numLabels = 0;
+        for (int i = 0; i < tournament->numPlayers; i++) {
+            if (set & (1 << i)) {
+                labels[numLabels++] = i + SHIFT;
+            }
+        }
+        labels[numLabels] = '\0';
+        fprintf(stdout, "winners %s %ld\n", labels, rounds->winners[set]);
+    }
+    for (int t = 0; t < DECK_SIZE; t++) {
+        if (rounds->lengths[t] > 0) {
+            fprintf(stdout, "length %d %ld\n", t, rounds->lengths[t]);
+        }
+    }
+    fprintf(stdout, "threads %d\n", tournament->numWorkers);
+    fprintf(stdout, "seconds %.3f\n", seconds);
+    fprintf(stdout, "decks/sec %.0f\n",
+            seconds > 0 ? rounds->rounds / seconds : 0.0);
+}
+
+/*
+ * Opens the checkpoint file at path for an enumeration, which is named
+ * by header (a line). If it is for the same enumeration, marks the blocks
+ * it has done and adds their totals to rounds, dropping any line left
+ * half written; otherwise it must not exist, and is started. Exits with
+ * CHECKPOINT_ERROR if the file cannot be used.
+ */
+void open_checkpoint(Tournament* tournament, const char* path,
+        const char* header, RoundStats* rounds) {
+    char line[CHECKPOINT_LINE];
+    long kept = 0; //bytes of whole lines to keep
+    long numBlocks = (tournament->numDecks + ENUMERATE_BLOCK - 1) /
+            ENUMERATE_BLOCK;
+    FILE* file = fopen(path, "r");
+
+    if (file != NULL) {
+        if (fgets(line, CHECKPOINT_LINE, file) == NULL ||
+                strcmp(line, header) != 0) {
+            exit_with(CHECKPOINT_ERROR);
+        }
+        kept = ftell(file);
+        while (fgets(line, CHECKPOINT_LINE, file) != NULL) {
+            RoundStats block;
+            char* fields;
+            long b = strncmp(line, "block ", 6) == 0 ?
+                    strtol(line + 6, &fields, 10) : -1;
+            if (b < 0 || b >= numBlocks ||
+                    !read_block(fields, &block, tournament->numPlayers)) {
+                break;
+            }
+            if (!tournament->done[b]) {
+                tournament->done[b] = true;
+                add_round_stats(rounds, &block);
+            }
+            kept = ftell(file);
+        }
+        fclose(file);
+        if (truncate(path, kept) == -1) {
+            exit_with(CHECKPOINT_ERROR);
+        }
+    }
+    tournament->checkpoint = fopen(path, "a");
+    if (tournament->checkpoint == NULL) {
+        exit_with(CHECKPOINT_ERROR);
+    }
+    if (kept == 0) {
+        fputs(header, tournament->checkpoint);
+        fflush(tournament->checkpoint);
+    }
+}
+
+/*
+ * The main function
+ */
+int main(int argc, char** argv) {
+    Tournament tournament;
+    BatchStats stats;
+    RoundStats rounds;
+    long numGames = -1; //games to play (or decks to play a round on)
+    bool seeded = false; //true to generate decks instead of a deckfile
+    uint64_t seed = 0; //the seed to generate decks from
+    long numDecks = LONG_MAX; //how many decks to generate before repeating
+    struct option longOptions[] = {
+        {"seed", required_argument, NULL, OPTION_SEED},
+        {"decks", required_argument, NULL, OPTION_DECKS},
+        {"enumerate", no_argument, NULL, OPTION_ENUMERATE},
+        {"checkpoint", required_argument, NULL, OPTION_CHECKPOINT},
+        {"solve", required_argument, NULL, OPTION_SOLVE},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+
+    memset(&tournament, 0, sizeof(Tournament));
+    memset(&stats, 0, sizeof(BatchStats));
+    memset(&rounds, 0, sizeof(RoundStats));
+    tournament.numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    bool scalar = false; //true to play every game a strategy at a time
+    bool enumerating = false; //true to play a round on every deck
+    int solvePlayers = 0; //the seats to solve rounds for, if solving
+    char* checkpointPath = NULL; //the checkpoint file of an enumeration
+    while ((opt = getopt_long(argc, argv, "j:n:d:s", longOptions,
+            NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                tournament.numWorkers = atoi(optarg);
+                break;
+            case 'n':
+                numGames = atol(optarg);
+                break;
+            case 'd':
+                tournament.firstDeck = atol(optarg);
+                break;
+            case 's':
+                scalar = true;
+                break;
+            case OPTION_SEED:
+                seeded = true;
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case OPTION_DECKS:
+                numDecks = atol(optarg);
+                break;
+            case OPTION_ENUMERATE:
+                enumerating = true;
+                break;
+            case OPTION_CHECKPOINT:
+                checkpointPath = optarg;
+                break;
+            case OPTION_SOLVE:
+                solvePlayers = atoi(optarg);
+                if (solvePlayers < 1) {
+                    exit_with(USAGE_ERROR);
+                }
+                break;
+            default:
+                exit_with(USAGE_ERROR);
+        }
+    }
+    int numSources = seeded || enumerating ? 0 : 1;
+    tournament.numPlayers = solvePlayers > 0 ? solvePlayers :
+            argc - optind - numSources;
+    tournament.byDeck = enumerating || solvePlayers > 0;
+    if (numGames == -1) {
+        numGames = enumerating ? (long)NUM_ORDERINGS - tournament.firstDeck :
+                100000;
+    }
+    if (tournament.numPlayers < MIN_PLAYERS ||
+            tournament.numPlayers > MAX_PLAYERS ||
+            tournament.numWorkers < 1 || numGames < 0 ||
+            tournament.firstDeck < 0 || numDecks < 1 ||
+            (enumerating && (seeded || tournament.firstDeck + numGames >
+            (long)NUM_ORDERINGS)) ||
+            (checkpointPath != NULL && !enumerating) ||
+            (solvePlayers > 0 && argc - optind != numSources)) {
+        exit_with(USAGE_ERROR);
+    }
+
+    //load the deck corpus, or make decks up as they are wanted
+    DeckCorpus* corpus;
+    if (enumerating) {
+        corpus = enumerate_decks();
+    } else if (seeded) {
+        corpus = generate_decks(seed, numDecks);
+    } else {
+        FILE* deckFile = fopen(argv[optind], "r");
+        if (deckFile == NULL) {
+            exit_with(ACCESS_ERROR);
+        }
+        corpus = load_decks(deckFile);
+        fclose(deckFile);
+        if (corpus == NULL) {
+            exit_with(DECK_ERROR);
+        }
+    }
+    tournament.corpus = corpus;
+
+    //find the strategy for each seat, unless every seat is solved
+    char** strategies = argv + argc - tournament.numPlayers;
+    for (int i = 0; i < tournament.numPlayers && solvePlayers == 0; i++) {
+        tournament.seats[i] = find_strategy(strategies[i]);
+        if (tournament.seats[i] == NULL) {
+            exit_with(STRATEGY_ERROR);
+        }
+    }
+    //games between basic seats alone can be played in lockstep
+    tournament.lockstep = !scalar && solvePlayers == 0;
+    for (int i = 0; i < tournament.numPlayers; i++) {
+        tournament.lockstep = tournament.lockstep &&
+                tournament.seats[i] == &basicStrategy;
+    }
+    tournament.chunk = tournament.lockstep ? LOCKSTEP_CHUNK : CHUNK;
+
+    //a round on each deck shares out blocks of decks, not games
+    long numWork = numGames;
+    if (tournament.byDeck) {
+        tournament.lockstep = false;
+        tournament.chunk = 1;
+        tournament.numDecks = numGames;
+        numWork = (numGames + ENUMERATE_BLOCK - 1) / ENUMERATE_BLOCK;
+        tournament.done = calloc(numWork + 1, sizeof(bool));
+        pthread_mutex_init(&tournament.checkpointLock, NULL);
+    }
+    if (solvePlayers > 0) {
+        tournament.solver = create_solver(SOLVER_TABLE_BITS);
+    }
+    if (checkpointPath != NULL) {
+        char header[CHECKPOINT_LINE];
+        int length = snprintf(header, CHECKPOINT_LINE, "enumerate %ld %ld",
+                tournament.firstDeck, numGames);
+        for (int i = 0; i < tournament.numPlayers; i++) {
+            length += snprintf(header + length, CHECKPOINT_LINE - length,
+                    " %s", solvePlayers > 0 ? "solved" : strategies[i]);
+        }
+        if (length >= CHECKPOINT_LINE - 1) {
+            exit_with(CHECKPOINT_ERROR);
+        }
+        strcpy(header + length, "\n");
+        open_checkpoint(&tournament, checkpointPath, header, &rounds);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int result = play_tournament(&tournament, numWork, &stats, &rounds);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (result != MOVE_OK) {
+        exit_with(MOVE_ERROR);
+    }
+    double seconds = (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (tournament.byDeck) {
+        print_enumeration(&tournament, &rounds, seconds);
+    } else {
+        print_results(&tournament, &stats, seconds);
+    }
+
+    if (tournament.checkpoint != NULL) {
+        fclose(tournament.checkpoint);
+    }
+    if (tournament.solver != NULL) {
+        free_solver(tournament.solver);
+    }
+    free(tournament.done);
+    free_corpus(corpus);
+    return NORMAL_EXIT;
+}
@@ -0,0 +1,143 @@
+/*
+ * Binary player traces (libloveletter)
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trace.h"
+
+/* Bytes before the first record of a trace file */
+#define TRACE_HEADER 7
+
+/*
+ * Sets up trace for the player label of numPlayers players, to be
+ * written to prefix.label.pid when flushed.
+ */
+void init_trace(Trace* trace, const char* prefix, char label,
+        int numPlayers) {
+    trace->head = 0;
+    trace->tail = 0;
+    trace->label = label;
+    trace->numPlayers = numPlayers;
+    snprintf(trace->path, TRACE_PATH, "%s.%c.%d", prefix, label,
+            (int)getpid());
+}
+
+/*
+ * Adds a record of type with length bytes of data (at most
+ * TRACE_MAX_RECORD) to trace, dropping the oldest records to make room.
+ */
+void trace_record(Trace* trace, int type, const void* data, int length) {
+    const unsigned char* bytes = data;
+    uint64_t size = length + 2;
+
+    while (trace->head + size - trace->tail > TRACE_SIZE) {
+        trace->tail += trace->buffer[(trace->tail + 1) % TRACE_SIZE] + 2;
+    }
+    //a signal handler may flush the ring between any two of these steps,
+    //so the old records go before the new one overwrites them
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    trace->buffer[trace->head % TRACE_SIZE] = type;
+    trace->buffer[(trace->head + 1) % TRACE_SIZE] = length;
+    for (int i = 0; i < length; i++) {
+        trace->buffer[(trace->head + 2 + i) % TRACE_SIZE] = bytes[i];
+    }
+    //and only a whole record is ever part of the ring
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    trace->head += size;
+}
+
+/*
+ * Writes trace out to its file. Only uses async-signal-safe calls, so
+ * it can be called from a signal handler. Returns false if the file
+ * could not be written.
+ */
+bool flush_trace(const Trace* trace) {
+    unsigned char header[TRACE_HEADER] = {TRACE_MAGIC[0], TRACE_MAGIC[1],
+            TRACE_MAGIC[2], TRACE_MAGIC[3], TRACE_VERSION, trace->label,
+            trace->numPlayers};
+    uint64_t start = trace->tail % TRACE_SIZE;
+    uint64_t used = trace->head - trace->tail;
+    //the records may wrap around the end of the buffer
+    uint64_t first = used < TRACE_SIZE - start ? used : TRACE_SIZE - start;
+    bool written;
+
+    int fd = open(trace->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    written = write(fd, header, TRACE_HEADER) == TRACE_HEADER &&
+            write(fd, trace->buffer + start, first) == first &&
+            write(fd, trace->buffer, used - first) == used - first;
+    close(fd);
+    return written;
+}
+
+/*
+ * Prints the status lines of a status record of numPlayers players.
+ * Returns false if the record is cut short.
+ */
+static bool print_status(FILE* out, const unsigned char* record,
+        int length, int numPlayers) {
+    int at = 0;
+
+    for (int i = 0; i < numPlayers; i++) {
+        if (at + 2 > length) {
+            return false;
+        }
+        char designator = record[at];
+        int numberPlayed = record[at + 1];
+        at += 2;
+        if (at + numberPlayed > length) {
+            return false;
+        }
+        fprintf(out, "%c%c:%.*s\n", 'A' + i, designator, numberPlayed,
+                record + at);
+        at += numberPlayed;
+    }
+    if (at + 2 != length) {
+        return false;
+    }
+    fprintf(out, "You are holding:%c%c\n", record[at], record[at + 1]);
+    return true;
+}
+
+/*
+ * Prints the lines a player would have printed to stderr for the trace
+ * file in, oldest first. Returns 0, or 1 if in is not a whole trace.
+ */
+int decode_trace(FILE* in, FILE* out) {
+    unsigned char header[TRACE_HEADER];
+    unsigned char record[TRACE_MAX_RECORD];
+    int type;
+    int length;
+
+    if (fread(header, 1, TRACE_HEADER, in) != TRACE_HEADER ||
+            memcmp(header, TRACE_MAGIC, 4) != 0 ||
+            header[4] != TRACE_VERSION) {
+        return 1;
+    }
+    while ((type = fgetc(in)) != EOF) {
+        if ((length = fgetc(in)) == EOF ||
+                fread(record, 1, length, in) != length) {
+            return 1;
+        }
+        switch (type) {
+            case TRACE_FROM_HUB:
+                fprintf(out, "From hub:%.*s\n", length, record);
+                break;
+            case TRACE_TO_HUB:
+                fprintf(out, "To hub:%.*s\n", length, record);
+                break;
+            case TRACE_STATUS:
+                if (!print_status(out, record, length, header[6])) {
+                    return 1;
+                }
+                break;
+            default:
+                return 1;
+        }
+    }
+    return 0;
+}
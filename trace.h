@@ -0,0 +1,64 @@
+/*
+ * Binary player traces (libloveletter)
+ *
+ * Instead of formatting its status to stderr after every message, a
+ * player can keep compact binary records of what it would have printed
+ * in an in-memory ring, overwriting the oldest once it is full. The
+ * ring is only written out to a file when asked (SIGUSR1) or when the
+ * player dies abnormally; tracedump turns the file back into the lines
+ * the player would have printed.
+ *
+ * File: TRACE_MAGIC, then a byte each for the version, the player's
+ * label and the number of players, then records oldest first. Each
+ * record is a type byte, a length byte and length bytes of payload:
+ * - from hub, to hub: the text of the message
+ * - status: per player a designator char, the number of cards played
+ *   and the cards played as chars, then the two cards held as chars
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The environment variable naming the file prefix to trace to */
+#define TRACE_ENV "LOVELETTER_TRACE"
+#define TRACE_MAGIC "LLTR"
+#define TRACE_VERSION 1
+/* Bytes of records kept (a power of 2) */
+#define TRACE_SIZE 65536
+/* The longest path of a trace file */
+#define TRACE_PATH 256
+/* Record types */
+#define TRACE_FROM_HUB 1
+#define TRACE_TO_HUB 2
+#define TRACE_STATUS 3
+/* The largest payload of a record */
+#define TRACE_MAX_RECORD 255
+
+/* A ring of trace records
+ * - head: bytes ever written
+ * - tail: where the oldest record still kept starts
+ * - path: the file to write the ring to
+ * - label: the player's label
+ * - numPlayers: the number of players
+ * - buffer: the records, byte n at buffer[n % TRACE_SIZE]
+ */
+typedef struct Trace {
+    uint64_t head;
+    uint64_t tail;
+    char path[TRACE_PATH];
+    char label;
+    int numPlayers;
+    unsigned char buffer[TRACE_SIZE];
+} Trace;
+
+void init_trace(Trace* trace, const char* prefix, char label,
+        int numPlayers);
+void trace_record(Trace* trace, int type, const void* data, int length);
+bool flush_trace(const Trace* trace);
+int decode_trace(FILE* in, FILE* out);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * The tracedump program
+ *
+ * Turns the trace files a player flushes (see trace.h) back into the
+ * status lines it would have printed to stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace.h"
+
+/*Error exit statuses*/
+#define NORMAL_EXIT 0
+#define USAGE_ERROR 1
+#define ACCESS_ERROR 2
+#define TRACE_ERROR 3
+
+/*
+ * Exits the process with the given exitStatus.
+ */
+void exit_with(int exitStatus) {
+    switch(exitStatus) {
+        case 1:
+            fprintf(stderr, "Usage: tracedump tracefile\n");
+            break;
+        case 2:
+            fprintf(stderr, "Unable to access tracefile\n");
+            break;
+        case 3:
+            fprintf(stderr, "Error reading trace\n");
+            break;
+        default:
+            break;
+    }
+    exit(exitStatus);
+}
+
+/*
+ * The main function
+ */
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        exit_with(USAGE_ERROR);
+    }
+    FILE* traceFile = fopen(argv[1], "r");
+    if (traceFile == NULL) {
+        exit_with(ACCESS_ERROR);
+    }
+    int result = decode_trace(traceFile, stdout);
+    fclose(traceFile);
+    if (result != 0) {
+        exit_with(TRACE_ERROR);
+    }
+    return NORMAL_EXIT;
+}
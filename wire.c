@@ -0,0 +1,180 @@
+/*
+ * The binary wire protocol (libloveletter)
+ */
+
+#include <stdio.h>
+#include "wire.h"
+
+/* The code for '-' as a card and as a player */
+#define NO_CARD 15
+#define NO_PLAYER 7
+
+/*
+ * Returns the size of a hub record of the given type, or 0 if there is
+ * no such type.
+ */
+int wire_size(int type) {
+    switch (type) {
+        case WIRE_NEWROUND:
+        case WIRE_YOURTURN:
+        case WIRE_REPLACE:
+        case WIRE_NEWGAME:
+        case WIRE_GAMEOVER:
+            return 2;
+        case WIRE_SCORES:
+            return 3;
+        case WIRE_THISHAPPENED:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Returns the text protocol name of a record type.
+ */
+const char* wire_name(int type) {
+    static const char* names[] = {"", "newround", "yourturn",
+            "thishappened", "replace", "scores", "newgame", "gameover"};
+    return wire_size(type) ? names[type] : "";
+}
+
+/*
+ * Returns the 4 bit code for a card or guess char.
+ */
+int encode_card(char card) {
+    return (card >= '0' && card <= '9') ? card - '0' : NO_CARD;
+}
+
+/*
+ * Returns the char for a 4 bit card code. Codes that are not a digit or
+ * '-' come back as '?', which fails every check.
+ */
+char decode_card(int code) {
+    if (code <= 9) {
+        return code + '0';
+    }
+    return code == NO_CARD ? '-' : '?';
+}
+
+/*
+ * Returns the 3 bit code for a player char.
+ */
+int encode_player(char player) {
+    return (player >= 'A' && player <= 'D') ? player - 'A' : NO_PLAYER;
+}
+
+/*
+ * Returns the char for a 3 bit player code ('?' if there is none).
+ */
+char decode_player(int code) {
+    if (code <= 3) {
+        return code + 'A';
+    }
+    return code == NO_PLAYER ? '-' : '?';
+}
+
+/*
+ * Packs a thishappened into record.
+ */
+void encode_event(unsigned char record[4], char player, char card,
+        char target, char guess, char dropper, char dropped,
+        char eliminated) {
+    unsigned long bits = encode_player(player) |
+            encode_card(card) << 3 |
+            encode_player(target) << 7 |
+            encode_card(guess) << 10 |
+            encode_player(dropper) << 14 |
+            encode_card(dropped) << 17 |
+            (unsigned long)encode_player(eliminated) << 21;
+
+    record[0] = WIRE_THISHAPPENED;
+    record[1] = bits & 0xff;
+    record[2] = (bits >> 8) & 0xff;
+    record[3] = (bits >> 16) & 0xff;
+}
+
+/*
+ * Unpacks a thishappened record into its text form pcpc/pcp.
+ */
+void decode_event(const unsigned char record[4], char message[9]) {
+    unsigned long bits = record[1] | record[2] << 8 |
+            (unsigned long)record[3] << 16;
+
+    message[0] = decode_player(bits & 0x7);
+    message[1] = decode_card((bits >> 3) & 0xf);
+    message[2] = decode_player((bits >> 7) & 0x7);
+    message[3] = decode_card((bits >> 10) & 0xf);
+    message[4] = '/';
+    message[5] = decode_player((bits >> 14) & 0x7);
+    message[6] = decode_card((bits >> 17) & 0xf);
+    message[7] = decode_player((bits >> 21) & 0x7);
+    message[8] = '\0';
+}
+
+/*
+ * Packs the scores of numPlayers players into record.
+ */
+void encode_scores(unsigned char record[3], const int* scores,
+        int numPlayers) {
+    record[0] = WIRE_SCORES;
+    record[1] = 0;
+    record[2] = 0;
+    for (int i = 0; i < numPlayers; i++) {
+        record[1 + i / 2] |= (scores[i] & 0xf) << (4 * (i % 2));
+    }
+}
+
+/*
+ * Packs a reply c1pc2 into record.
+ */
+void encode_move(unsigned char record[2], char card, char target,
+        char guess) {
+    record[0] = encode_card(card) << 4 | encode_card(guess);
+    record[1] = encode_player(target);
+}
+
+/*
+ * Unpacks a reply record into its text form c1pc2.
+ */
+void decode_move(const unsigned char record[2], char move[3]) {
+    move[0] = decode_card(record[0] >> 4);
+    move[1] = decode_player(record[1] & 0x7);
+    move[2] = decode_card(record[0] & 0xf);
+    //anything in the unused bits makes it a bad reply
+    if (record[1] > 0x7) {
+        move[1] = '?';
+    }
+}
+
+/*
+ * Writes the text protocol form of a hub record (without \n) to text,
+ * for a game of numPlayers players.
+ */
+void format_record(const unsigned char* record, int numPlayers,
+        char text[WIRE_MAX_TEXT + 1]) {
+    char event[9];
+    int length;
+
+    switch (record[0]) {
+        case WIRE_THISHAPPENED:
+            decode_event(record, event);
+            sprintf(text, "thishappened %s", event);
+            break;
+        case WIRE_SCORES:
+            length = sprintf(text, "scores");
+            for (int i = 0; i < numPlayers && i < 4; i++) {
+                length += sprintf(text + length, " %d",
+                        (record[1 + i / 2] >> (4 * (i % 2))) & 0xf);
+            }
+            break;
+        case WIRE_NEWGAME:
+        case WIRE_GAMEOVER:
+            sprintf(text, "%s", wire_name(record[0]));
+            break;
+        default:
+            sprintf(text, "%s %c", wire_name(record[0]),
+                    decode_card(record[1]));
+            break;
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * The binary wire protocol (libloveletter)
+ *
+ * An opt-in alternative to the text protocol. A hub that wants it sets
+ * WIRE_ENV to "binary" for each player; a player that can speak it
+ * answers the startup handshake with WIRE_BINARY instead of WIRE_TEXT.
+ * From then on each hub message is a fixed size record whose first byte
+ * is its type, and each reply is a WIRE_MOVE_SIZE byte record.
+ *
+ * Records (cards and guesses are 4 bit codes: digit d is d, '-' is 15;
+ * players are 3 bit codes: 'A' is 0, '-' is 7):
+ * - newround, yourturn, replace: type, card
+ * - thishappened: type, then 24 bits holding player, card, target,
+ *   guess, dropper, dropped and eliminated (first in the low bits)
+ * - scores: type, then a 4 bit score per player (first in the low bits)
+ * - newgame, gameover: type, 0
+ * - reply: card << 4 | guess, target
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+/* The environment variable a hub uses to offer the binary protocol */
+#define WIRE_ENV "LOVELETTER_WIRE"
+/* Handshake chars sent by a player on startup */
+#define WIRE_TEXT '-'
+#define WIRE_BINARY '+'
+/* Record types */
+#define WIRE_NEWROUND 1
+#define WIRE_YOURTURN 2
+#define WIRE_THISHAPPENED 3
+#define WIRE_REPLACE 4
+#define WIRE_SCORES 5
+#define WIRE_NEWGAME 6
+#define WIRE_GAMEOVER 7
+/* Record sizes */
+#define WIRE_MOVE_SIZE 2
+#define WIRE_MAX_SIZE 4
+/* The longest text form of a record (scores with 4 players) */
+#define WIRE_MAX_TEXT 22
+
+int wire_size(int type);
+const char* wire_name(int type);
+int encode_card(char card);
+char decode_card(int code);
+int encode_player(char player);
+char decode_player(int code);
+void encode_event(unsigned char record[4], char player, char card,
+        char target, char guess, char dropper, char dropped,
+        char eliminated);
+void decode_event(const unsigned char record[4], char message[9]);
+void encode_scores(unsigned char record[3], const int* scores,
+        int numPlayers);
+void encode_move(unsigned char record[2], char card, char target,
+        char guess);
+void decode_move(const unsigned char record[2], char move[3]);
+void format_record(const unsigned char* record, int numPlayers,
+        char text[WIRE_MAX_TEXT + 1]);
+
+#endif